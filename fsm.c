@@ -35,21 +35,126 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "fsm.h"
+#include "fsm_array.h"
+#include "fsm_bus.h"
+#include "fsm_dispatch.h"
+#include "fsm_fleet.h"
+#include "fsm_record.h"
+#include "fsm_wheel.h"
+
+#include <stddef.h>
+#include <string.h>
 
 /* External variables --------------------------------------------------------*/
 
 /* Private typedef -----------------------------------------------------------*/
+typedef enum {
+  GUARD_OP_CMP = 0, /* acc = events[arg] */
+  GUARD_OP_TIMEOUT, /* acc = elapsed >= timeouts[arg] */
+  GUARD_OP_NOT,     /* acc = !acc */
+  GUARD_OP_JF,      /* if !acc jump to arg */
+  GUARD_OP_JT,      /* if acc jump to arg */
+} guard_op_t;
+
+typedef struct {
+  uint8_t op;
+  uint8_t arg;
+} guard_instr_t;
+
+/* The operands and the code are allocated in the same block that the header */
+struct fsm_guard {
+  fsm_event_t *events;
+  uint32_t *timeouts;
+  guard_instr_t *code;
+  size_t len;
+};
 
 /* Private macro -------------------------------------------------------------*/
+#if FSM_PACKED_LAYOUT
+#define VERSION_STAMP(v) ((uint16_t)(v))
+#else
+#define VERSION_STAMP(v) (v)
+#endif
+
+#define ASYNC_COMPLETING UINT32_MAX /* Operation taken by its completion */
 
 /* Private function prototypes -----------------------------------------------*/
-static uint8_t get_next_state(fsm_trans_list_t *trans_list,
-                              uint8_t current_state, uint32_t elapsed_ms);
-static void execute_action(uint8_t current_state,
-                           fsm_actions_list_t *actions_list,
-                           fsm_action_type_t type);
-static bool eval_events(fsm_trans_t *trans);
+static uint8_t get_next_state(fsm_t *const me, uint32_t elapsed,
+                              uint32_t *enabled_at);
+static void execute_action(fsm_t *const me, fsm_action_type_t type);
+static void call_action(fsm_t *const me, const fsm_action_t *action,
+                        fsm_action_type_t type);
+static void invoke_action(fsm_t *const me, const fsm_action_t *action);
+static void check_dwell(fsm_t *const me, uint32_t now_ms);
+static void report_violation(fsm_t *const me, fsm_violation_t *violation);
+static const fsm_budget_t *state_budget(fsm_t *const me);
+static bool eval_events(fsm_t *const me, fsm_trans_t *trans);
 static bool eval_timeout(fsm_trans_t *trans, uint32_t elapsed_time);
+static uint32_t ms_to_ticks(fsm_t *const me, uint32_t ms);
+static uint32_t elapsed_ticks(fsm_t *const me, uint64_t now);
+static bool eval_preds(fsm_t *const me, size_t index, fsm_preds_t *bits,
+                       fsm_preds_t *done);
+static fsm_err_t compile_preds(fsm_t *const me);
+static void free_preds(fsm_t *const me);
+static fsm_err_t add_event(fsm_t *const me, fsm_trans_t *trans, int *val,
+                           fsm_input_t *input, int cmp, fsm_eval_fn_t eval,
+                           bool ctx);
+static bool memo_hit(fsm_t *const me, fsm_trans_t *trans);
+static bool count_expr(const fsm_expr_t *expr, size_t *events,
+                       size_t *timeouts, size_t *code);
+static fsm_err_t emit_expr(fsm_t *const me, fsm_guard_t *guard,
+                           const fsm_expr_t *expr, size_t *events,
+                           size_t *timeouts);
+static bool eval_guard(fsm_t *const me, const fsm_guard_t *guard,
+                       uint32_t elapsed_ms);
+static void schedule_timer(fsm_t *const me, uint64_t now_ticks);
+static bool is_running(fsm_t *const me);
+static bool owns_trans(fsm_t *const me, const fsm_trans_t *trans);
+static void publish_state(fsm_t *const me, uint8_t prev_state, uint16_t seq);
+static void adopt_definition(fsm_t *const me);
+static void swap_definition(fsm_t *const a, fsm_t *const b);
+static void retire_definition(fsm_t *const me, fsm_t *def);
+static void free_definition(fsm_t *const me);
+static void memo_store(fsm_t *const me, fsm_trans_t *trans, bool res);
+#if FSM_PACKED_LAYOUT
+static void drop_memos(fsm_t *const me, uint8_t state);
+#endif
+static fsm_err_t build_observers(fsm_t *const me);
+static void notify_observers(fsm_t *const me, uint8_t from_state,
+                             uint8_t to_state);
+static bool observer_in_group(const fsm_observer_t *observer, size_t state,
+                              size_t len);
+static fsm_event_t *trans_events(fsm_t *const me, const fsm_trans_t *trans);
+static size_t trans_events_len(const fsm_trans_t *trans);
+#if FSM_PACKED_LAYOUT
+static bool shares_events(fsm_t *const me, const fsm_trans_t *trans);
+#endif
+static fsm_action_t *trans_action(fsm_t *const me, const fsm_trans_t *trans);
+static fsm_guard_t *trans_guard(fsm_t *const me, const fsm_trans_t *trans);
+static fsm_err_t set_trans_action(fsm_t *const me, fsm_trans_t *trans,
+                                  fsm_action_t action);
+static fsm_err_t set_state_actions(fsm_t *const me, uint8_t state,
+                                   const fsm_action_t *actions);
+static fsm_err_t set_trans_guard(fsm_t *const me, fsm_trans_t *trans,
+                                 fsm_guard_t *guard);
+static fsm_eval_fn_t event_eval(fsm_t *const me, const fsm_event_t *event);
+static bool check_event(fsm_t *const me, const fsm_event_t *event);
+static bool same_eval(fsm_t *const me, const fsm_event_t *a,
+                      const fsm_event_t *b);
+static fsm_input_t *event_input(const fsm_event_t *event);
+static fsm_err_t set_event(fsm_t *const me, fsm_event_t *event, int *val,
+                           fsm_input_t *input, int cmp, fsm_eval_fn_t eval,
+                           bool ctx);
+static fsm_err_t check_table(fsm_t *const me, const fsm_table_t *table);
+static fsm_err_t copy_table(fsm_t *const me, const fsm_table_t *table);
+static uint8_t table_next_state(fsm_t *const me, uint32_t elapsed,
+                                uint32_t *enabled_at);
+static bool start_async(fsm_t *const me);
+static bool async_pending(fsm_t *const me);
+static void abort_async(fsm_t *const me);
+static uint8_t timeout_next_state(fsm_t *const me, uint32_t elapsed,
+                                  uint32_t *enabled_at);
+static size_t guard_size(const fsm_guard_t *guard);
 
 /* Private variables ---------------------------------------------------------*/
 
@@ -70,8 +175,192 @@ fsm_err_t fsm_init(fsm_t *const me, uint8_t init_state, fsm_time_t get_ms) {
   me->actions_list.len = 0;
   me->trans_list.trans = NULL;
   me->trans_list.len = 0;
+  me->table = NULL;
   me->get_ms = get_ms;
   me->entry_ms = 0;
+  me->time64.get_ticks = NULL;
+  me->time64.ticks_per_ms = 1;
+  me->time64.entry = 0;
+  me->time64.anchored = false;
+  me->eval_mode = FSM_EVAL_MODE_DEFAULT;
+  me->preds_list.preds = NULL;
+  me->preds_list.masks = NULL;
+  me->preds_list.len = 0;
+  me->memo_stats.hits = 0;
+  me->memo_stats.misses = 0;
+  me->wheel = NULL;
+  me->timer.next = NULL;
+  me->timer.prev = NULL;
+  me->timer.expiry_ms = 0;
+  me->fleet = NULL;
+  me->fleet_link.next = NULL;
+  me->fleet_link.prev = NULL;
+  me->fleet_link.state = init_state;
+  me->bus = NULL;
+  me->bus_rank = 0;
+  me->dispatch = NULL;
+  me->running = false;
+  me->recorder = NULL;
+  me->ctx = NULL;
+  me->budgets.budgets = NULL;
+  me->budgets.len = 0;
+  me->budgets.get_ticks = NULL;
+  me->budgets.fn = NULL;
+  me->budgets.arg = NULL;
+  me->budgets.stats.dwell = 0;
+  me->budgets.stats.action = 0;
+  me->budgets.dwell_reported = false;
+  me->async.actions = NULL;
+  me->async.len = 0;
+  me->async.pending = 0;
+  me->async.seq = 0;
+  me->async.result.val = 0;
+  me->async.result.version = 0;
+  me->async.notify = NULL;
+  me->async.arg = NULL;
+  me->observers.head = NULL;
+  me->observers.table = NULL;
+  me->observers.offsets = NULL;
+  me->observers.len = 0;
+  me->rcu.pending = NULL;
+  me->rcu.retired = NULL;
+  me->rcu.next = NULL;
+  me->rcu.map = NULL;
+  me->rcu.map_len = 0;
+#if FSM_PACKED_LAYOUT
+  me->events_pool.events = NULL;
+  me->events_pool.len = 0;
+  me->evals_pool.evals = NULL;
+  me->evals_pool.len = 0;
+  me->trans_actions_pool.actions = NULL;
+  me->trans_actions_pool.len = 0;
+  me->guards_pool.guards = NULL;
+  me->guards_pool.len = 0;
+#endif
+  publish_state(me, init_state, 0);
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to deinitialize a FSM instance.
+ */
+fsm_err_t fsm_deinit(fsm_t *const me) {
+  /* Check if the FSM instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the FSM instance is running */
+  if (is_running(me)) {
+    return FSM_ERR_BUSY;
+  }
+
+  if (me->wheel != NULL) {
+    fsm_wheel_remove(me->wheel, me);
+  }
+
+  if (me->fleet != NULL) {
+    fsm_fleet_remove(me->fleet, me);
+  }
+
+  if (me->bus != NULL) {
+    fsm_bus_remove(me->bus, me);
+  }
+
+  /* Free the definitions not adopted or not reclaimed yet */
+  fsm_t *def = __atomic_exchange_n(&me->rcu.pending, NULL, __ATOMIC_ACQUIRE);
+  if (def != NULL) {
+    retire_definition(me, def);
+  }
+
+  do {
+    fsm_reclaim(me, &def);
+  } while (def != NULL);
+
+  free_definition(me);
+  free(me->budgets.budgets);
+  me->budgets.budgets = NULL;
+  me->budgets.len = 0;
+  free(me->async.actions);
+  me->async.actions = NULL;
+  me->async.len = 0;
+  me->async.notify = NULL;
+
+  /* The completion of an operation still pending fails */
+  __atomic_store_n(&me->async.pending, 0, __ATOMIC_RELAXED);
+  free(me->observers.table);
+  free(me->observers.offsets);
+  me->observers.head = NULL;
+  me->observers.table = NULL;
+  me->observers.offsets = NULL;
+  me->observers.len = 0;
+  me->dispatch = NULL;
+  me->recorder = NULL;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to get the heap memory allocated by a FSM instance.
+ */
+fsm_err_t fsm_memory_usage(fsm_t *const me, fsm_memory_usage_t *usage) {
+  /* Check if the FSM instance and the usage pointer are valid */
+  if (me == NULL || usage == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  usage->trans =
+      fsm_array_capacity(me->trans_list.len) * sizeof *me->trans_list.trans;
+  usage->events = 0;
+  usage->actions = fsm_array_capacity(me->actions_list.len) *
+                   sizeof *me->actions_list.actions;
+  usage->guards = 0;
+  usage->other = 0;
+
+#if FSM_PACKED_LAYOUT
+  usage->events =
+      fsm_array_capacity(me->events_pool.len) * sizeof *me->events_pool.events;
+  usage->actions += fsm_array_capacity(me->trans_actions_pool.len) *
+                    sizeof *me->trans_actions_pool.actions;
+  usage->other +=
+      fsm_array_capacity(me->evals_pool.len) * sizeof *me->evals_pool.evals +
+      fsm_array_capacity(me->guards_pool.len) * sizeof *me->guards_pool.guards;
+
+  for (size_t i = 0; i < me->guards_pool.len; i++) {
+    usage->guards += guard_size(me->guards_pool.guards[i]);
+  }
+#else
+  for (size_t i = 0; i < me->trans_list.len; i++) {
+    fsm_trans_t *trans = &me->trans_list.trans[i];
+    usage->events += fsm_array_capacity(trans->events_list.len) *
+                     sizeof *trans->events_list.events;
+    usage->guards += guard_size(trans->guard);
+  }
+#endif
+
+  /* Predicates of FSM_EVAL_MODE_BITSET */
+  if (me->preds_list.preds != NULL) {
+    usage->other += FSM_PREDS_MAX * sizeof *me->preds_list.preds +
+                    (me->trans_list.len ? me->trans_list.len : 1) *
+                        sizeof *me->preds_list.masks;
+  }
+
+  usage->other +=
+      fsm_array_capacity(me->budgets.len) * sizeof *me->budgets.budgets +
+      fsm_array_capacity(me->async.len) * sizeof *me->async.actions;
+
+  /* Observers groups */
+  if (me->observers.table != NULL) {
+    size_t entries = me->observers.offsets[me->observers.len + 1];
+    usage->other += (entries ? entries : 1) * sizeof *me->observers.table +
+                    (me->observers.len + 2) * sizeof *me->observers.offsets;
+  }
+
+  usage->total = usage->trans + usage->events + usage->actions +
+                 usage->guards + usage->other;
 
   /* Return success */
   return FSM_ERR_OK;
@@ -87,14 +376,24 @@ fsm_err_t fsm_add_transition(fsm_t *const me, fsm_trans_t **trans,
     return FSM_ERR_INVALID_PARAM;
   }
 
+  /* Check if the FSM instance is running */
+  if (is_running(me)) {
+    return FSM_ERR_BUSY;
+  }
+
+  /* Check if the definition is a table loaded by reference */
+  if (me->table != NULL) {
+    return FSM_ERR_FAIL;
+  }
+
   /* Check is the transition states are valid */
   if (from_state == next_state) {
     return FSM_ERR_INVALID_PARAM;
   }
 
   /* Allocate memory for the new transition and check*/
-  fsm_trans_t *ptr =
-      realloc(me->trans_list.trans, (me->trans_list.len + 1) * sizeof *ptr);
+  fsm_trans_t *ptr = fsm_array_grow(me->trans_list.trans, me->trans_list.len,
+                                    me->trans_list.len + 1, sizeof *ptr);
 
   if (ptr == NULL) {
     return FSM_ERR_NO_MEM;
@@ -106,18 +405,32 @@ fsm_err_t fsm_add_transition(fsm_t *const me, fsm_trans_t **trans,
 
   /* Set the values for the new transition element */
   size_t index = me->trans_list.len - 1;
+#if FSM_PACKED_LAYOUT
+  me->trans_list.trans[index].events = (uint16_t)me->events_pool.len;
+  me->trans_list.trans[index].events_len = 0;
+  me->trans_list.trans[index].action = FSM_SLOT_NONE;
+  me->trans_list.trans[index].guard = FSM_SLOT_NONE;
+#else
   me->trans_list.trans[index].events_list.events = NULL;
   me->trans_list.trans[index].events_list.len = 0;
+  me->trans_list.trans[index].action.fn = NULL;
+  me->trans_list.trans[index].action.arg = NULL;
+  me->trans_list.trans[index].guard = NULL;
+#endif
   me->trans_list.trans[index].present_state = from_state;
   me->trans_list.trans[index].next_state = next_state;
   me->trans_list.trans[index].op = FSM_OP_AND; /* default operator */
-  me->trans_list.trans[index].action.fn = NULL;
-  me->trans_list.trans[index].action.arg = NULL;
   me->trans_list.trans[index].timeout = 0;
+  me->trans_list.trans[index].memo.enabled = false;
+  me->trans_list.trans[index].memo.valid = false;
+  me->trans_list.trans[index].memo.res = false;
 
   /* Assign the last transition added to transition out parameter */
   *trans = &me->trans_list.trans[index];
 
+  /* Drop the predicates table, the next fsm_run() builds it again */
+  free_preds(me);
+
   /* Return success */
   return FSM_ERR_OK;
 }
@@ -131,62 +444,192 @@ fsm_err_t fsm_set_event_op(fsm_t *const me, fsm_trans_t *trans, fsm_op_t op) {
     return FSM_ERR_INVALID_PARAM;
   }
 
-  /* Set the new operator */
+  /* Set the new operator and discard the cached result */
   trans->op = op;
+  trans->memo.valid = false;
 
   /* Return success */
   return FSM_ERR_OK;
 }
 
 /**
- * @brief Function to add an event for a transition for a FSM instance.
+ * @brief Function to set the mode used to evaluate the transition events.
  */
-fsm_err_t fsm_add_event_cmp(fsm_t *const me, fsm_trans_t *trans, int *val,
-                            int cmp, fsm_eval_t eval) {
+fsm_err_t fsm_set_eval_mode(fsm_t *const me, fsm_eval_mode_t mode) {
   /* Check if the FSM instance is valid */
   if (me == NULL) {
     return FSM_ERR_INVALID_PARAM;
   }
 
-  /* Check if the transition pointer is valid */
-  if (trans == NULL) {
+  /* Check if the FSM instance is running */
+  if (is_running(me)) {
+    return FSM_ERR_BUSY;
+  }
+
+  /* Check if the evaluation mode is valid */
+  if (mode < 0 || mode >= FSM_EVAL_MODE_MAX) {
     return FSM_ERR_INVALID_PARAM;
   }
 
-  /* Check if the event value pointer is valid */
-  if (val == NULL) {
+  if (mode == FSM_EVAL_MODE_DEFAULT) {
+    free_preds(me);
+    me->eval_mode = mode;
+    return FSM_ERR_OK;
+  }
+
+  /* Check if the definition is a table loaded by reference */
+  if (me->table != NULL) {
+    return FSM_ERR_FAIL;
+  }
+
+  /* Build the predicates table, the mode is set only if it succeed */
+  me->eval_mode = mode;
+  return compile_preds(me);
+}
+
+/**
+ * @brief Function to get the mode used to evaluate the transition events.
+ */
+fsm_err_t fsm_get_eval_mode(fsm_t *const me, fsm_eval_mode_t *mode) {
+  /* Check if the FSM instance and the mode pointer are valid */
+  if (me == NULL || mode == NULL) {
     return FSM_ERR_INVALID_PARAM;
   }
 
-  /* Check if the evaluation function is valid */
-  if (eval == NULL) {
+  *mode = me->eval_mode;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to add an event for a transition for a FSM instance.
+ */
+fsm_err_t fsm_add_event_cmp(fsm_t *const me, fsm_trans_t *trans, int *val,
+                            int cmp, fsm_eval_t eval) {
+  fsm_err_t ret =
+      add_event(me, trans, val, NULL, cmp, (fsm_eval_fn_t){.eval = eval}, false);
+
+  /* Plain int events can't be cached */
+  if (ret == FSM_ERR_OK) {
+    trans->memo.enabled = false;
+  }
+
+  return ret;
+}
+
+/**
+ * @brief Function to add an event evaluated with the instance context for a
+ *        transition for a FSM instance.
+ */
+fsm_err_t fsm_add_event_cmp_ctx(fsm_t *const me, fsm_trans_t *trans, int *val,
+                                int cmp, fsm_eval_ctx_t eval) {
+  fsm_err_t ret = add_event(me, trans, val, NULL, cmp,
+                            (fsm_eval_fn_t){.eval_ctx = eval}, true);
+
+  /* Plain int events can't be cached */
+  if (ret == FSM_ERR_OK) {
+    trans->memo.enabled = false;
+  }
+
+  return ret;
+}
+
+/**
+ * @brief Function to initialize a versioned input.
+ */
+fsm_err_t fsm_input_init(fsm_input_t *in, int val) {
+  /* Check if the input pointer is valid */
+  if (in == NULL) {
     return FSM_ERR_INVALID_PARAM;
   }
 
-  /* Check if the transition is part of the FSM */
-  fsm_trans_t *base = me->trans_list.trans;
-  size_t len = me->trans_list.len;
-  if (!(trans >= base && trans < base + len)) {
-    return FSM_ERR_FAIL;
+  in->val = val;
+  in->version = 0;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to set the value of a versioned input.
+ */
+fsm_err_t fsm_input_set(fsm_input_t *in, int val) {
+  /* Check if the input pointer is valid */
+  if (in == NULL) {
+    return FSM_ERR_INVALID_PARAM;
   }
 
-  /* Allocate memory for the new event and check */
-  fsm_event_t *ptr = realloc(trans->events_list.events,
-                             (trans->events_list.len + 1) * sizeof *ptr);
+  /* Update the version only if the value changes */
+  if (in->val != val) {
+    in->val = val;
+    in->version++;
+  }
 
-  if (ptr == NULL) {
-    return FSM_ERR_NO_MEM;
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to add a versioned input event for a transition for a FSM
+ *        instance.
+ */
+fsm_err_t fsm_add_event_input(fsm_t *const me, fsm_trans_t *trans,
+                              fsm_input_t *in, int cmp, fsm_eval_t eval) {
+  /* Check if the input pointer is valid */
+  if (in == NULL) {
+    return FSM_ERR_INVALID_PARAM;
   }
 
-  /* Assign the reallocated memory and add 1 to len */
-  trans->events_list.events = ptr;
-  trans->events_list.len++;
+  fsm_err_t ret = add_event(me, trans, &in->val, in, cmp,
+                            (fsm_eval_fn_t){.eval = eval}, false);
 
-  /* Set the values for the new event element */
-  size_t index = trans->events_list.len - 1;
-  trans->events_list.events[index].val = val;
-  trans->events_list.events[index].cmp = cmp;
-  trans->events_list.events[index].eval = eval;
+  /* The transition is cacheable while all its events are inputs */
+  if (ret == FSM_ERR_OK) {
+    if (trans_events_len(trans) == 1) {
+      trans->memo.enabled = true;
+    }
+    trans->memo.valid = false;
+  }
+
+  return ret;
+}
+
+/**
+ * @brief Function to add a versioned input event evaluated with the instance
+ *        context for a transition for a FSM instance.
+ */
+fsm_err_t fsm_add_event_input_ctx(fsm_t *const me, fsm_trans_t *trans,
+                                  fsm_input_t *in, int cmp,
+                                  fsm_eval_ctx_t eval) {
+  /* Check if the input pointer is valid */
+  if (in == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  fsm_err_t ret = add_event(me, trans, &in->val, in, cmp,
+                            (fsm_eval_fn_t){.eval_ctx = eval}, true);
+
+  /* The result can depend on the data behind the context, which has no
+  version, so the transition can't be cached */
+  if (ret == FSM_ERR_OK) {
+    trans->memo.enabled = false;
+  }
+
+  return ret;
+}
+
+/**
+ * @brief Function to get the cached events evaluation counters of a FSM
+ *        instance.
+ */
+fsm_err_t fsm_get_memo_stats(fsm_t *const me, fsm_memo_stats_t *stats) {
+  /* Check if the FSM instance and the stats pointer are valid */
+  if (me == NULL || stats == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  *stats = me->memo_stats;
 
   /* Return success */
   return FSM_ERR_OK;
@@ -208,22 +651,23 @@ fsm_err_t fsm_add_event_timeout(fsm_t *const me, fsm_trans_t *trans,
   }
 
   /* Check if the pointer to get ms is valid */
-  if (me->get_ms == NULL) {
+  if (me->get_ms == NULL && me->time64.get_ticks == NULL) {
     return FSM_ERR_INVALID_PARAM;
   }
 
   /* Assign new tiemout */
-  trans->timeout = timeout;
+  trans->timeout = ms_to_ticks(me, timeout);
 
   /* Return success */
   return FSM_ERR_OK;
 }
 
 /**
- * @brief Function to register an action for a FSM state transition.
+ * @brief Function to add a timeout event in ticks for a transition for a FSM
+ *        instance.
  */
-fsm_err_t fsm_register_trans_action(fsm_t *const me, fsm_trans_t *trans,
-                                    fsm_fn_t fn, void *arg) {
+fsm_err_t fsm_add_event_timeout_ticks(fsm_t *const me, fsm_trans_t *trans,
+                                      uint32_t timeout) {
   /* Check if the FSM instance is valid */
   if (me == NULL) {
     return FSM_ERR_INVALID_PARAM;
@@ -234,183 +678,2339 @@ fsm_err_t fsm_register_trans_action(fsm_t *const me, fsm_trans_t *trans,
     return FSM_ERR_INVALID_PARAM;
   }
 
-  /* Assign the action function pointer */
-  trans->action.fn = fn;
-  trans->action.arg = arg;
+  /* Check if the pointer to get the time is valid */
+  if (me->get_ms == NULL && me->time64.get_ticks == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  trans->timeout = timeout;
 
   /* Return success */
   return FSM_ERR_OK;
 }
 
 /**
- * @brief Function to register callbacks for a FSM state.
+ * @brief Function to set a 64-bit time source for a FSM instance.
  */
-fsm_err_t fsm_register_state_actions(fsm_t *const me, uint8_t state,
-                                     fsm_fn_t entry_fn, void *entry_arg,
-                                     fsm_fn_t update_fn, void *update_arg,
-                                     fsm_fn_t exit_fn, void *exit_arg) {
+fsm_err_t fsm_set_time_source(fsm_t *const me, fsm_time64_t get_ticks,
+                              uint32_t ticks_per_ms) {
   /* Check if the FSM instance is valid */
   if (me == NULL) {
     return FSM_ERR_INVALID_PARAM;
   }
 
-  if (state >= me->actions_list.len) {
-    /* Allocate */
-    fsm_action_t(*ptr)[3] =
-        realloc(me->actions_list.actions, (state + 1) * sizeof *ptr);
-
-    if (ptr == NULL) {
-      return FSM_ERR_NO_MEM;
-    }
+  /* Check if the time source is valid */
+  if (get_ticks == NULL || !ticks_per_ms) {
+    return FSM_ERR_INVALID_PARAM;
+  }
 
-    me->actions_list.actions = ptr;
-    me->actions_list.len = state + 1;
+  /* The timeouts already added are in other unit, and the recorder logs the
+  time in ms */
+  if (me->trans_list.len || me->recorder != NULL) {
+    return FSM_ERR_FAIL;
   }
 
-  me->actions_list.actions[state][FSM_ACTION_TYPE_ENTRY].fn = entry_fn;
-  me->actions_list.actions[state][FSM_ACTION_TYPE_ENTRY].arg = entry_arg;
-  me->actions_list.actions[state][FSM_ACTION_TYPE_UPDATE].fn = update_fn;
-  me->actions_list.actions[state][FSM_ACTION_TYPE_UPDATE].arg = update_arg;
-  me->actions_list.actions[state][FSM_ACTION_TYPE_EXIT].fn = exit_fn;
-  me->actions_list.actions[state][FSM_ACTION_TYPE_EXIT].arg = exit_arg;
+  me->time64.get_ticks = get_ticks;
+  me->time64.ticks_per_ms = ticks_per_ms;
 
   /* Return success */
   return FSM_ERR_OK;
 }
 
 /**
- * @brief Function to run FSM instance.
+ * @brief Function to set a guard expression for a transition for a FSM
+ *        instance.
  */
-fsm_err_t fsm_run(fsm_t *const me) {
+fsm_err_t fsm_set_guard(fsm_t *const me, fsm_trans_t *trans,
+                        const fsm_expr_t *expr) {
   /* Check if the FSM instance is valid */
   if (me == NULL) {
     return FSM_ERR_INVALID_PARAM;
   }
 
-  /* Read the current time */
-  uint32_t now_ms = me->get_ms ? me->get_ms() : 0;
-
-  /* Execute the enter action if the current FSM state comes from a different
-  state and update the previous FSM state. In other case execute the update
-  action */
-  if (me->current_state != me->prev_state) {
-    me->entry_ms = now_ms;
-    execute_action(me->current_state, &me->actions_list, FSM_ACTION_TYPE_ENTRY);
-    me->prev_state = me->current_state;
-  } else {
-    execute_action(me->current_state, &me->actions_list,
-                   FSM_ACTION_TYPE_UPDATE);
+  /* Check if the FSM instance is running */
+  if (is_running(me)) {
+    return FSM_ERR_BUSY;
   }
 
-  /* Evaluate the transition event and get the next FSM state. If the current
-  FSM state change then execute the exit action */
-  uint8_t next_state =
-      get_next_state(&me->trans_list, me->current_state, now_ms - me->entry_ms);
+  /* Check if the transition is part of the FSM, the packed layout indexes
+  its pools */
+  if (trans == NULL || !owns_trans(me, trans)) {
+    return FSM_ERR_INVALID_PARAM;
+  }
 
-  if (next_state != me->current_state) {
-    execute_action(me->current_state, &me->actions_list, FSM_ACTION_TYPE_EXIT);
-    me->prev_state = me->current_state;
-    me->current_state = next_state;
+  /* Remove the guard */
+  if (expr == NULL) {
+    return set_trans_guard(me, trans, NULL);
   }
 
-  /* Return success */
-  return FSM_ERR_OK;
-}
+  /* Validate the expression and get the size of the compiled guard */
+  size_t events = 0, timeouts = 0, code = 0;
+  if (!count_expr(expr, &events, &timeouts, &code)) {
+    return FSM_ERR_INVALID_PARAM;
+  }
 
-/* Private functions ---------------------------------------------------------*/
-static uint8_t get_next_state(fsm_trans_list_t *trans_list,
-                              uint8_t current_state, uint32_t elapsed_ms) {
-  for (size_t i = 0; i < trans_list->len; i++) {
-    /* Find coincidences for current state */
-    fsm_trans_t *trans = &trans_list->trans[i];
-    if (trans->present_state == current_state) {
-      if (!trans->events_list.len && !trans->timeout) {
-        goto TRANSITION;
-      }
+  if (events > FSM_GUARD_MAX || timeouts > FSM_GUARD_MAX ||
+      code > FSM_GUARD_MAX) {
+    return FSM_ERR_FAIL;
+  }
 
-      /* Set condition initial value according the operator */
-      bool res = 0;
-      bool cmp_res = 0;
-      bool timeout_res = 0;
+  /* Allocate the header, operands and code in a single block */
+  fsm_guard_t *guard =
+      malloc(sizeof *guard + events * sizeof *guard->events +
+             timeouts * sizeof *guard->timeouts + code * sizeof *guard->code);
 
-      /* Evaluate all transition events */
-      cmp_res = eval_events(trans);
+  if (guard == NULL) {
+    return FSM_ERR_NO_MEM;
+  }
 
-      /* Evalute timeout event */
-      timeout_res = eval_timeout(trans, elapsed_ms);
+  guard->events = (fsm_event_t *)(guard + 1);
+  guard->timeouts = (uint32_t *)(guard->events + events);
+  guard->code = (guard_instr_t *)(guard->timeouts + timeouts);
+  guard->len = 0;
 
-      if (trans->op == FSM_OP_AND) {
-        res = cmp_res & timeout_res;
-      } else {
-        res = cmp_res | timeout_res;
-      }
+  /* Compile the expression */
+  events = 0;
+  timeouts = 0;
+  fsm_err_t ret = emit_expr(me, guard, expr, &events, &timeouts);
 
-      if (res) {
-      TRANSITION:
-        /* Execute the transition action */
-        if (trans->action.fn != NULL) {
-          trans->action.fn(trans->action.arg);
-        }
+  /* Replace the previous guard */
+  if (ret == FSM_ERR_OK) {
+    ret = set_trans_guard(me, trans, guard);
+  }
 
-        /* Return the next state */
-        return trans->next_state;
-      }
-    }
+  if (ret != FSM_ERR_OK) {
+    free(guard);
   }
 
-  /* Return the current state as next state */
-  return current_state;
+  return ret;
 }
 
-static void execute_action(uint8_t current_state,
-                           fsm_actions_list_t *actions_list,
-                           fsm_action_type_t type) {
-  /* Check if actions type is valid*/
-  if (type < FSM_ACTION_TYPE_ENTRY || type >= FSM_ACTION_TYPE_MAX) {
-    return;
+/**
+ * @brief Function to register an action for a FSM state transition.
+ */
+fsm_err_t fsm_register_trans_action(fsm_t *const me, fsm_trans_t *trans,
+                                    fsm_fn_t fn, void *arg) {
+  /* Check if the FSM instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
   }
 
-  /* Check if the current FSM state callback was registered */
-  if (current_state < actions_list->len) {
-    if (actions_list->actions[current_state][type].fn != NULL) {
-      actions_list->actions[current_state][type].fn(
-          actions_list->actions[current_state][type].arg);
-    }
+  /* Check if the FSM instance is running, the packed layout can move the
+  actions pool */
+  if (is_running(me)) {
+    return FSM_ERR_BUSY;
   }
-}
 
-static bool eval_events(fsm_trans_t *trans) {
-  bool ret = trans->op == FSM_OP_AND ? 1 : 0;
+  /* Check if the transition is part of the FSM, the packed layout indexes
+  its pools */
+  if (trans == NULL || !owns_trans(me, trans)) {
+    return FSM_ERR_INVALID_PARAM;
+  }
 
-  if (!trans->events_list.len) {
-    return ret;
+  /* Assign the action function pointer */
+  return set_trans_action(me, trans,
+                          (fsm_action_t){.fn = fn, .arg = arg, .ctx = false});
+}
+
+/**
+ * @brief Function to register an action that gets the instance context for a
+ *        FSM state transition.
+ */
+fsm_err_t fsm_register_trans_action_ctx(fsm_t *const me, fsm_trans_t *trans,
+                                        fsm_fn_ctx_t fn, void *arg) {
+  /* Check if the FSM instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
   }
 
-  for (size_t i = 0; i < trans->events_list.len; i++) {
-    fsm_event_t event = trans->events_list.events[i];
-    if (event.val != NULL) {
-      /* Perform the comparation */
-      if (trans->op == FSM_OP_AND) {
-        ret &= event.eval(*event.val, event.cmp);
-      } else {
-        ret |= event.eval(*event.val, event.cmp);
-      }
-    }
+  /* Check if the FSM instance is running, the packed layout can move the
+  actions pool */
+  if (is_running(me)) {
+    return FSM_ERR_BUSY;
   }
 
-  return ret;
+  /* Check if the transition is part of the FSM, the packed layout indexes
+  its pools */
+  if (trans == NULL || !owns_trans(me, trans)) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Assign the action function pointer */
+  return set_trans_action(
+      me, trans, (fsm_action_t){.fn_ctx = fn, .arg = arg, .ctx = true});
 }
 
-static bool eval_timeout(fsm_trans_t *trans, uint32_t elapsed_time) {
-  bool ret = trans->op == FSM_OP_AND ? 1 : 0;
+/**
+ * @brief Function to register callbacks for a FSM state.
+ */
+fsm_err_t fsm_register_state_actions(fsm_t *const me, uint8_t state,
+                                     fsm_fn_t entry_fn, void *entry_arg,
+                                     fsm_fn_t update_fn, void *update_arg,
+                                     fsm_fn_t exit_fn, void *exit_arg) {
+  /* Check if the FSM instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
 
-  if (!trans->timeout) {
+  const fsm_action_t actions[] = {
+      [FSM_ACTION_TYPE_ENTRY] = {.fn = entry_fn, .arg = entry_arg},
+      [FSM_ACTION_TYPE_UPDATE] = {.fn = update_fn, .arg = update_arg},
+      [FSM_ACTION_TYPE_EXIT] = {.fn = exit_fn, .arg = exit_arg},
+  };
+
+  return set_state_actions(me, state, actions);
+}
+
+/**
+ * @brief Function to register callbacks that get the instance context for a
+ *        FSM state.
+ */
+fsm_err_t fsm_register_state_actions_ctx(fsm_t *const me, uint8_t state,
+                                         fsm_fn_ctx_t entry_fn,
+                                         void *entry_arg,
+                                         fsm_fn_ctx_t update_fn,
+                                         void *update_arg,
+                                         fsm_fn_ctx_t exit_fn,
+                                         void *exit_arg) {
+  /* Check if the FSM instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  const fsm_action_t actions[] = {
+      [FSM_ACTION_TYPE_ENTRY] = {.fn_ctx = entry_fn, .arg = entry_arg,
+                                 .ctx = true},
+      [FSM_ACTION_TYPE_UPDATE] = {.fn_ctx = update_fn, .arg = update_arg,
+                                  .ctx = true},
+      [FSM_ACTION_TYPE_EXIT] = {.fn_ctx = exit_fn, .arg = exit_arg,
+                                .ctx = true},
+  };
+
+  return set_state_actions(me, state, actions);
+}
+
+/**
+ * @brief Function to set the context of a FSM instance.
+ */
+fsm_err_t fsm_set_context(fsm_t *const me, void *ctx) {
+  /* Check if the FSM instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  me->ctx = ctx;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to get the context of a FSM instance.
+ */
+fsm_err_t fsm_get_context(fsm_t *const me, void **ctx) {
+  /* Check if the FSM instance and the context pointer are valid */
+  if (me == NULL || ctx == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  *ctx = me->ctx;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to load the whole definition of a FSM instance from a table.
+ */
+fsm_err_t fsm_load(fsm_t *const me, const fsm_table_t *table,
+                   fsm_load_mode_t mode) {
+  /* Check if the FSM instance and the table are valid */
+  if (me == NULL || table == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the FSM instance is running */
+  if (is_running(me)) {
+    return FSM_ERR_BUSY;
+  }
+
+  /* Check if the load mode is valid */
+  if (mode < 0 || mode >= FSM_LOAD_MAX) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the FSM instance has no definition yet */
+  if (me->trans_list.len || me->actions_list.len || me->table != NULL) {
+    return FSM_ERR_FAIL;
+  }
+
+  /* Check all the rows and events before storing anything */
+  fsm_err_t ret = check_table(me, table);
+
+  if (ret != FSM_ERR_OK) {
     return ret;
   }
 
-  ret = elapsed_time >= trans->timeout;
+  if (mode == FSM_LOAD_REF) {
+    /* The predicates table can't be kept in sync with a read only table */
+    if (me->eval_mode == FSM_EVAL_MODE_BITSET) {
+      return FSM_ERR_FAIL;
+    }
+
+    me->table = table;
+    return FSM_ERR_OK;
+  }
+
+  fsm_eval_mode_t eval_mode = me->eval_mode;
+  ret = copy_table(me, table);
+
+  if (ret != FSM_ERR_OK) {
+    /* Leave the instance without definition, in the same evaluation mode */
+    free_definition(me);
+    me->eval_mode = eval_mode;
+    return ret;
+  }
+
+  /* Build the predicates table of the new transitions */
+  if (me->eval_mode == FSM_EVAL_MODE_BITSET) {
+    return compile_preds(me);
+  }
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to register an asynchronous action for a FSM state.
+ */
+fsm_err_t fsm_register_state_async(fsm_t *const me, uint8_t state,
+                                   fsm_async_fn_t fn, void *arg) {
+  /* Check if the FSM instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the FSM instance is running */
+  if (is_running(me)) {
+    return FSM_ERR_BUSY;
+  }
+
+  if (state >= me->async.len) {
+    fsm_async_action_t *ptr = fsm_array_grow(me->async.actions, me->async.len,
+                                             state + 1, sizeof *ptr);
+
+    if (ptr == NULL) {
+      return FSM_ERR_NO_MEM;
+    }
+
+    /* The states between the last one with action and this one have none */
+    memset(&ptr[me->async.len], 0, (state + 1 - me->async.len) * sizeof *ptr);
+    me->async.actions = ptr;
+    me->async.len = state + 1;
+  }
+
+  me->async.actions[state].fn = fn;
+  me->async.actions[state].arg = arg;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to set the function called when an asynchronous operation
+ *        of a FSM instance completes.
+ */
+fsm_err_t fsm_set_async_notify(fsm_t *const me, fsm_async_notify_t notify,
+                               void *arg) {
+  /* Check if the FSM instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  me->async.notify = notify;
+  me->async.arg = arg;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to complete the asynchronous operation of a FSM instance.
+ */
+fsm_err_t fsm_async_complete(fsm_async_t op, int result) {
+  fsm_t *me = op.fsm;
+
+  /* Check if the handle is valid */
+  if (me == NULL || op.id == 0 || op.id == ASYNC_COMPLETING) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Take the operation, a stale or repeated completion finds other value */
+  uint32_t expected = op.id;
+  if (!__atomic_compare_exchange_n(&me->async.pending, &expected,
+                                   ASYNC_COMPLETING, false, __ATOMIC_ACQUIRE,
+                                   __ATOMIC_RELAXED)) {
+    return FSM_ERR_FAIL;
+  }
+
+  /* The release pairs with the acquire in async_pending(), so the next run
+  sees the result */
+  fsm_input_set(&me->async.result, result);
+  __atomic_store_n(&me->async.pending, 0, __ATOMIC_RELEASE);
+
+  if (me->async.notify != NULL) {
+    me->async.notify(me, me->async.arg);
+  }
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to get the versioned input with the result of the last
+ *        asynchronous operation of a FSM instance.
+ */
+fsm_err_t fsm_get_async_result(fsm_t *const me, fsm_input_t **result) {
+  /* Check if the FSM instance and the result pointer are valid */
+  if (me == NULL || result == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  *result = &me->async.result;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to set the dispatch queue of a FSM instance.
+ */
+fsm_err_t fsm_set_dispatch(fsm_t *const me, struct fsm_dispatch *dispatch) {
+  /* Check if the FSM instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  me->dispatch = dispatch;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to set the latency budgets of a FSM state.
+ */
+fsm_err_t fsm_set_state_budget(fsm_t *const me, uint8_t state,
+                               uint32_t dwell_ms, uint32_t action_ticks) {
+  /* Check if the FSM instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the FSM instance is running */
+  if (is_running(me)) {
+    return FSM_ERR_BUSY;
+  }
+
+  if (state >= me->budgets.len) {
+    fsm_budget_t *ptr = fsm_array_grow(me->budgets.budgets, me->budgets.len,
+                                       state + 1, sizeof *ptr);
+
+    if (ptr == NULL) {
+      return FSM_ERR_NO_MEM;
+    }
+
+    /* The states between the last one with budget and this one have none */
+    memset(&ptr[me->budgets.len], 0,
+           (state + 1 - me->budgets.len) * sizeof *ptr);
+    me->budgets.budgets = ptr;
+    me->budgets.len = state + 1;
+  }
+
+  me->budgets.budgets[state].dwell_ms = dwell_ms;
+  me->budgets.budgets[state].action_ticks = action_ticks;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to set the handler of the budget violations of a FSM
+ *        instance.
+ */
+fsm_err_t fsm_set_budget_handler(fsm_t *const me, fsm_violation_fn_t fn,
+                                 void *arg, fsm_time_t get_ticks) {
+  /* Check if the FSM instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  me->budgets.fn = fn;
+  me->budgets.arg = arg;
+  me->budgets.get_ticks = get_ticks;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to get the budget violation counters of a FSM instance.
+ */
+fsm_err_t fsm_get_budget_stats(fsm_t *const me, fsm_budget_stats_t *stats) {
+  /* Check if the FSM instance and the stats pointer are valid */
+  if (me == NULL || stats == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  *stats = me->budgets.stats;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to subscribe an observer to the transitions of a FSM
+ *        instance.
+ */
+fsm_err_t fsm_subscribe(fsm_t *const me, fsm_observer_t *observer,
+                        int from_state, int to_state, fsm_observer_fn_t fn,
+                        void *arg) {
+  /* Check if the FSM instance and the observer are valid */
+  if (me == NULL || observer == NULL || fn == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the FSM instance is running */
+  if (is_running(me)) {
+    return FSM_ERR_BUSY;
+  }
+
+  /* Check if the state filters are valid */
+  if (from_state < FSM_STATE_ANY || from_state > UINT8_MAX ||
+      to_state < FSM_STATE_ANY || to_state > UINT8_MAX) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  observer->fn = fn;
+  observer->arg = arg;
+  observer->from_state = (int16_t)from_state;
+  observer->to_state = (int16_t)to_state;
+  observer->next = NULL;
+
+  /* Add the observer at the end, so they are notified in subscription order */
+  fsm_observer_t **link = &me->observers.head;
+  while (*link != NULL) {
+    link = &(*link)->next;
+  }
+  *link = observer;
+
+  fsm_err_t ret = build_observers(me);
+  if (ret != FSM_ERR_OK) {
+    *link = NULL;
+  }
+
+  return ret;
+}
+
+/**
+ * @brief Function to unsubscribe an observer from the transitions of a FSM
+ *        instance.
+ */
+fsm_err_t fsm_unsubscribe(fsm_t *const me, fsm_observer_t *observer) {
+  /* Check if the FSM instance and the observer are valid */
+  if (me == NULL || observer == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the FSM instance is running */
+  if (is_running(me)) {
+    return FSM_ERR_BUSY;
+  }
+
+  /* Look for the observer */
+  fsm_observer_t **link = &me->observers.head;
+  while (*link != NULL && *link != observer) {
+    link = &(*link)->next;
+  }
+
+  if (*link == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  *link = observer->next;
+
+  fsm_err_t ret = build_observers(me);
+  if (ret != FSM_ERR_OK) {
+    *link = observer;
+  }
 
   return ret;
 }
 
+/**
+ * @brief Function to set the input recorder of a FSM instance.
+ */
+fsm_err_t fsm_set_recorder(fsm_t *const me, struct fsm_recorder *recorder) {
+  /* Check if the FSM instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the FSM instance is running */
+  if (is_running(me)) {
+    return FSM_ERR_BUSY;
+  }
+
+  /* Check if the FSM instance runs in ms, the log and the replay can't keep
+  the ticks of a 64-bit time source */
+  if (recorder != NULL && me->time64.get_ticks != NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Watch the inputs of the events and the guards */
+  for (size_t i = 0; recorder != NULL && i < me->trans_list.len; i++) {
+    fsm_trans_t *trans = &me->trans_list.trans[i];
+    fsm_event_t *events = trans_events(me, trans);
+    fsm_err_t ret = FSM_ERR_OK;
+
+    for (size_t j = 0; j < trans_events_len(trans) && ret == FSM_ERR_OK; j++) {
+      ret = fsm_recorder_watch(recorder, events[j].val,
+                               event_input(&events[j]));
+    }
+
+    fsm_guard_t *guard = trans_guard(me, trans);
+    for (size_t j = 0; guard != NULL && j < guard->len && ret == FSM_ERR_OK;
+         j++) {
+      if (guard->code[j].op == GUARD_OP_CMP) {
+        fsm_event_t *event = &guard->events[guard->code[j].arg];
+        ret = fsm_recorder_watch(recorder, event->val, NULL);
+      }
+    }
+
+    if (ret != FSM_ERR_OK) {
+      return ret;
+    }
+  }
+
+  /* Watch the inputs of the rows of a table loaded by reference */
+  const fsm_table_t *table = me->table;
+  for (size_t i = 0; recorder != NULL && table != NULL && i < table->rows_len;
+       i++) {
+    const fsm_table_row_t *row = &table->rows[i];
+    for (size_t j = 0; j < row->events_len; j++) {
+      fsm_err_t ret =
+          fsm_recorder_watch(recorder, table->events[row->events + j].val, NULL);
+      if (ret != FSM_ERR_OK) {
+        return ret;
+      }
+    }
+  }
+
+  me->recorder = recorder;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to get a consistent snapshot of the state of a FSM instance.
+ */
+fsm_err_t fsm_get_snapshot(const fsm_t *const me, fsm_snapshot_t *snap) {
+  /* Check if the FSM instance and the snapshot pointer are valid */
+  if (me == NULL || snap == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  uint32_t word = __atomic_load_n(&me->state_word, __ATOMIC_ACQUIRE);
+  snap->state = (uint8_t)word;
+  snap->prev_state = (uint8_t)(word >> 8);
+  snap->seq = (uint16_t)(word >> 16);
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to publish a new definition for a running FSM instance.
+ */
+fsm_err_t fsm_publish(fsm_t *const me, fsm_t *def, const uint8_t *state_map,
+                      size_t map_len) {
+  /* Check if the FSM instances are valid */
+  if (me == NULL || def == NULL || def == me) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the states map is valid */
+  if (state_map == NULL && map_len) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the timeouts of the definition are in the same unit */
+  if (def->time64.ticks_per_ms != me->time64.ticks_per_ms) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  def->rcu.map = state_map;
+  def->rcu.map_len = map_len;
+
+  /* Publish the definition, the release pairs with the acquire in
+  adopt_definition() so the instance sees it completely built */
+  fsm_t *prev = __atomic_exchange_n(&me->rcu.pending, def, __ATOMIC_ACQ_REL);
+
+  /* The previous definition was never adopted */
+  if (prev != NULL) {
+    retire_definition(me, prev);
+  }
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to take a retired definition of a FSM instance.
+ */
+fsm_err_t fsm_reclaim(fsm_t *const me, fsm_t **def) {
+  /* Check if the FSM instance and the definition pointer are valid */
+  if (me == NULL || def == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Pop the first retired definition. There is a single consumer, so the head
+  can't be popped and pushed again by other thread between the load and the
+  exchange */
+  fsm_t *head = __atomic_load_n(&me->rcu.retired, __ATOMIC_ACQUIRE);
+  while (head != NULL &&
+         !__atomic_compare_exchange_n(&me->rcu.retired, &head, head->rcu.next,
+                                      true, __ATOMIC_ACQUIRE,
+                                      __ATOMIC_ACQUIRE)) {
+  }
+
+  if (head != NULL) {
+    head->rcu.next = NULL;
+    free_definition(head);
+
+    /* The budgets and the asynchronous actions were swapped with the
+    definition */
+    free(head->budgets.budgets);
+    head->budgets.budgets = NULL;
+    head->budgets.len = 0;
+    free(head->async.actions);
+    head->async.actions = NULL;
+    head->async.len = 0;
+  }
+
+  *def = head;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to run FSM instance.
+ */
+fsm_err_t fsm_run(fsm_t *const me) {
+  /* Check if the FSM instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Read the current time */
+  if (me->time64.get_ticks != NULL) {
+    return fsm_run_at_ticks(me, me->time64.get_ticks());
+  }
+
+  return fsm_run_at(me, me->get_ms ? me->get_ms() : 0);
+}
+
+/**
+ * @brief Function to run FSM instance at a given time.
+ */
+fsm_err_t fsm_run_at(fsm_t *const me, uint32_t now_ms) {
+  /* Check if the FSM instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  return fsm_run_at_ticks(me, (uint64_t)now_ms * me->time64.ticks_per_ms);
+}
+
+/**
+ * @brief Function to run FSM instance at a given time in ticks.
+ */
+fsm_err_t fsm_run_at_ticks(fsm_t *const me, uint64_t now_ticks) {
+  /* Check if the FSM instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the FSM instance is already running, e.g. fsm_run() called from
+  one of its actions or from other thread */
+  if (__atomic_exchange_n(&me->running, true, __ATOMIC_ACQUIRE)) {
+    return FSM_ERR_BUSY;
+  }
+
+  /* Switch to the last published definition */
+  if (__atomic_load_n(&me->rcu.pending, __ATOMIC_RELAXED) != NULL) {
+    adopt_definition(me);
+  }
+
+  /* Build the predicates table once after the definition changed, too many
+  predicates fall back to FSM_EVAL_MODE_DEFAULT */
+  if (me->eval_mode == FSM_EVAL_MODE_BITSET && me->preds_list.preds == NULL) {
+    compile_preds(me);
+  }
+
+  uint32_t now_ms = (uint32_t)(now_ticks / me->time64.ticks_per_ms);
+
+  /* Log the inputs before the actions and the events use them */
+  if (me->recorder != NULL) {
+    fsm_recorder_sample(me->recorder, now_ms);
+  }
+
+  /* Actions dropped before this run */
+  uint32_t dropped = me->dispatch != NULL ? me->dispatch->dropped : 0;
+
+  /* Execute the enter action if the current FSM state comes from a different
+  state and update the previous FSM state. In other case execute the update
+  action */
+  bool pending;
+  if (me->current_state != me->prev_state) {
+    /* Keep the instant of the transition when it is known */
+    if (!me->time64.anchored) {
+      me->time64.entry = now_ticks;
+    }
+    me->time64.anchored = false;
+    me->entry_ms = (uint32_t)(me->time64.entry / me->time64.ticks_per_ms);
+    me->budgets.dwell_reported = false;
+#if FSM_PACKED_LAYOUT
+    /* The cached results only keep the low bits of the input versions, the
+    inputs could change a multiple of 65536 times while away */
+    drop_memos(me, me->current_state);
+#endif
+    execute_action(me, FSM_ACTION_TYPE_ENTRY);
+    me->prev_state = me->current_state;
+    pending = start_async(me);
+  } else {
+    pending = async_pending(me);
+    if (!pending) {
+      execute_action(me, FSM_ACTION_TYPE_UPDATE);
+    }
+  }
+
+  /* Evaluate the transition event and get the next FSM state. If the current
+  FSM state change then execute the exit action. The events wait for the
+  asynchronous operation of the state, its timeouts don't */
+  uint32_t elapsed = elapsed_ticks(me, now_ticks);
+  uint32_t enabled_at = elapsed;
+  uint8_t next_state;
+  if (!pending) {
+    next_state = get_next_state(me, elapsed, &enabled_at);
+  } else {
+    next_state = timeout_next_state(me, elapsed, &enabled_at);
+  }
+
+  /* Check the time in the state, also when it is left late */
+  if (me->budgets.len) {
+    check_dwell(me, now_ms);
+  }
+
+  if (next_state != me->current_state) {
+    /* The state timed out before the operation completed */
+    if (pending) {
+      abort_async(me);
+    }
+
+    execute_action(me, FSM_ACTION_TYPE_EXIT);
+    me->prev_state = me->current_state;
+    me->current_state = next_state;
+
+    /* Enter the next state at the instant the transition was enabled, so a
+    late run doesn't delay the timeouts that follow */
+    me->time64.entry =
+        enabled_at < elapsed ? me->time64.entry + enabled_at : now_ticks;
+    me->time64.anchored = true;
+
+    /* Move the instance to the list of its new state */
+    if (me->fleet != NULL) {
+      fsm_fleet_update(me->fleet, me);
+    }
+
+    /* Publish the new state for other threads */
+    uint16_t seq = (uint16_t)(me->state_word >> 16);
+    publish_state(me, me->prev_state, seq + 1);
+
+    if (me->observers.head != NULL) {
+      notify_observers(me, me->prev_state, me->current_state);
+    }
+  }
+
+  /* Arm the timer with the next timeout of the current state */
+  if (me->wheel != NULL) {
+    schedule_timer(me, now_ticks);
+  }
+
+  /* Report the actions lost in this run */
+  fsm_err_t ret = FSM_ERR_OK;
+  if (me->dispatch != NULL && me->dispatch->dropped != dropped) {
+    ret = FSM_ERR_NO_MEM;
+  }
+
+  __atomic_store_n(&me->running, false, __ATOMIC_RELEASE);
+
+  return ret;
+}
+
+/**
+ * @brief Function to get the capacity allocated for an array.
+ */
+size_t fsm_array_capacity(size_t len) {
+  size_t cap = len ? 1 : 0;
+  while (cap < len) {
+    cap <<= 1;
+  }
+
+  return cap;
+}
+
+/**
+ * @brief Function to grow an array to a new length.
+ */
+void *fsm_array_grow(void *ptr, size_t len, size_t new_len, size_t size) {
+  /* Reallocate only when the length crosses a power of 2 */
+  size_t cap = fsm_array_capacity(new_len);
+  if (ptr != NULL && cap == fsm_array_capacity(len)) {
+    return ptr;
+  }
+
+  return realloc(ptr, cap * size);
+}
+
+/* Private functions ---------------------------------------------------------*/
+static uint8_t get_next_state(fsm_t *const me, uint32_t elapsed,
+                              uint32_t *enabled_at) {
+  fsm_trans_list_t *trans_list = &me->trans_list;
+  uint8_t current_state = me->current_state;
+
+  if (me->table != NULL) {
+    return table_next_state(me, elapsed, enabled_at);
+  }
+
+  /* Predicates evaluated in this run and their results */
+  fsm_preds_t bits = 0;
+  fsm_preds_t done = 0;
+
+  *enabled_at = elapsed;
+
+  for (size_t i = 0; i < trans_list->len; i++) {
+    /* Find coincidences for current state */
+    fsm_trans_t *trans = &trans_list->trans[i];
+    if (trans->present_state == current_state) {
+      fsm_guard_t *guard = trans_guard(me, trans);
+      if (guard != NULL) {
+        if (eval_guard(me, guard, elapsed)) {
+          goto TRANSITION;
+        }
+        continue;
+      }
+
+      if (!trans_events_len(trans) && !trans->timeout) {
+        goto TRANSITION;
+      }
+
+      /* Set condition initial value according the operator */
+      bool res = 0;
+      bool cmp_res = 0;
+      bool timeout_res = 0;
+
+      /* Evaluate all transition events, unless no input changed since the
+      last evaluation */
+      if (memo_hit(me, trans)) {
+        cmp_res = trans->memo.res;
+        me->memo_stats.hits++;
+      } else {
+        if (me->eval_mode == FSM_EVAL_MODE_BITSET) {
+          cmp_res = eval_preds(me, i, &bits, &done);
+        } else {
+          cmp_res = eval_events(me, trans);
+        }
+
+        if (trans->memo.enabled) {
+          memo_store(me, trans, cmp_res);
+          me->memo_stats.misses++;
+        }
+      }
+
+      /* Evalute timeout event */
+      timeout_res = eval_timeout(trans, elapsed);
+
+      if (trans->op == FSM_OP_AND) {
+        res = cmp_res & timeout_res;
+      } else {
+        res = cmp_res | timeout_res;
+      }
+
+      /* A transition enabled only by its timeout was enabled exactly when it
+      expired */
+      if (res && trans->timeout &&
+          (trans->op == FSM_OP_AND ? !trans_events_len(trans) : !cmp_res)) {
+        *enabled_at = trans->timeout;
+      }
+
+      if (res) {
+      TRANSITION:
+        /* Execute the transition action */
+        call_action(me, trans_action(me, trans), FSM_ACTION_TYPE_TRANS);
+
+        /* Return the next state */
+        return trans->next_state;
+      }
+    }
+  }
+
+  /* Return the current state as next state */
+  return current_state;
+}
+
+static fsm_err_t set_state_actions(fsm_t *const me, uint8_t state,
+                                   const fsm_action_t *actions) {
+  /* Check if the FSM instance is running */
+  if (is_running(me)) {
+    return FSM_ERR_BUSY;
+  }
+
+  /* Check if the definition is a table loaded by reference */
+  if (me->table != NULL) {
+    return FSM_ERR_FAIL;
+  }
+
+  if (state >= me->actions_list.len) {
+    /* Allocate */
+    fsm_action_t(*ptr)[3] = fsm_array_grow(
+        me->actions_list.actions, me->actions_list.len, state + 1, sizeof *ptr);
+
+    if (ptr == NULL) {
+      return FSM_ERR_NO_MEM;
+    }
+
+    /* The states between the last registered and this one have no actions */
+    memset(&ptr[me->actions_list.len], 0,
+           (state + 1 - me->actions_list.len) * sizeof *ptr);
+    me->actions_list.actions = ptr;
+    me->actions_list.len = state + 1;
+  }
+
+  memcpy(me->actions_list.actions[state], actions,
+         sizeof me->actions_list.actions[state]);
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+static void execute_action(fsm_t *const me, fsm_action_type_t type) {
+  /* Check if actions type is valid*/
+  if (type < FSM_ACTION_TYPE_ENTRY || type >= FSM_ACTION_TYPE_MAX) {
+    return;
+  }
+
+  /* Check if the current FSM state callback was registered */
+  const fsm_action_t *actions = NULL;
+  if (me->table != NULL) {
+    if (me->current_state < me->table->states_len) {
+      actions = me->table->states[me->current_state];
+    }
+  } else if (me->current_state < me->actions_list.len) {
+    actions = me->actions_list.actions[me->current_state];
+  }
+
+  if (actions != NULL) {
+    call_action(me, &actions[type], type);
+  }
+}
+
+static void call_action(fsm_t *const me, const fsm_action_t *action,
+                        fsm_action_type_t type) {
+  if (action == NULL || action->fn == NULL) {
+    return;
+  }
+
+  /* Defer the action */
+  if (me->dispatch != NULL) {
+    if (action->ctx) {
+      fsm_dispatch_push_ctx(me->dispatch, action->fn_ctx, me->ctx,
+                            action->arg);
+    } else {
+      fsm_dispatch_push(me->dispatch, action->fn, action->arg);
+    }
+    return;
+  }
+
+  /* Read the clock only if the action has a budget */
+  const fsm_budget_t *budget = state_budget(me);
+  fsm_time_t get_ticks =
+      me->budgets.get_ticks != NULL ? me->budgets.get_ticks : me->get_ms;
+
+  if (budget == NULL || !budget->action_ticks || get_ticks == NULL) {
+    invoke_action(me, action);
+    return;
+  }
+
+  uint32_t start = get_ticks();
+  invoke_action(me, action);
+  uint32_t measured = get_ticks() - start;
+
+  if (measured > budget->action_ticks) {
+    me->budgets.stats.action++;
+    fsm_violation_t violation = {.type = FSM_VIOLATION_ACTION,
+                                 .state = me->current_state,
+                                 .action = type,
+                                 .budget = budget->action_ticks,
+                                 .measured = measured,
+                                 .start = start};
+    report_violation(me, &violation);
+  }
+}
+
+static void invoke_action(fsm_t *const me, const fsm_action_t *action) {
+  if (action->ctx) {
+    action->fn_ctx(me->ctx, action->arg);
+  } else {
+    action->fn(action->arg);
+  }
+}
+
+static void check_dwell(fsm_t *const me, uint32_t now_ms) {
+  const fsm_budget_t *budget = state_budget(me);
+  uint32_t elapsed_ms = now_ms - me->entry_ms;
+
+  if (budget == NULL || !budget->dwell_ms || me->budgets.dwell_reported ||
+      elapsed_ms <= budget->dwell_ms) {
+    return;
+  }
+
+  /* Report once per visit of the state */
+  me->budgets.dwell_reported = true;
+  me->budgets.stats.dwell++;
+  fsm_violation_t violation = {.type = FSM_VIOLATION_DWELL,
+                               .state = me->current_state,
+                               .action = FSM_ACTION_TYPE_MAX,
+                               .budget = budget->dwell_ms,
+                               .measured = elapsed_ms,
+                               .start = me->entry_ms};
+  report_violation(me, &violation);
+}
+
+static void report_violation(fsm_t *const me, fsm_violation_t *violation) {
+  if (me->budgets.fn != NULL) {
+    me->budgets.fn(me, violation, me->budgets.arg);
+  }
+}
+
+static const fsm_budget_t *state_budget(fsm_t *const me) {
+  if (me->current_state >= me->budgets.len) {
+    return NULL;
+  }
+
+  return &me->budgets.budgets[me->current_state];
+}
+
+static bool eval_events(fsm_t *const me, fsm_trans_t *trans) {
+  bool ret = trans->op == FSM_OP_AND ? 1 : 0;
+  size_t len = trans_events_len(trans);
+
+  if (!len) {
+    return ret;
+  }
+
+  fsm_event_t *events = trans_events(me, trans);
+  for (size_t i = 0; i < len; i++) {
+    fsm_event_t event = events[i];
+    if (event.val != NULL) {
+      /* Perform the comparation */
+      if (trans->op == FSM_OP_AND) {
+        ret &= check_event(me, &event);
+      } else {
+        ret |= check_event(me, &event);
+      }
+    }
+  }
+
+  return ret;
+}
+
+static bool eval_timeout(fsm_trans_t *trans, uint32_t elapsed_time) {
+  bool ret = trans->op == FSM_OP_AND ? 1 : 0;
+
+  if (!trans->timeout) {
+    return ret;
+  }
+
+  ret = elapsed_time >= trans->timeout;
+
+  return ret;
+}
+
+static uint32_t ms_to_ticks(fsm_t *const me, uint32_t ms) {
+  uint64_t ticks = (uint64_t)ms * me->time64.ticks_per_ms;
+
+  return ticks > UINT32_MAX ? UINT32_MAX : (uint32_t)ticks;
+}
+
+static uint32_t elapsed_ticks(fsm_t *const me, uint64_t now) {
+  uint64_t elapsed = now - me->time64.entry;
+
+  /* The 32-bit ms clock wraps around, the 64-bit one saturates */
+  if (me->time64.get_ticks == NULL) {
+    return (uint32_t)elapsed;
+  }
+
+  return elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+}
+
+static bool eval_preds(fsm_t *const me, size_t index, fsm_preds_t *bits,
+                       fsm_preds_t *done) {
+  fsm_preds_t need = me->preds_list.masks[index];
+
+  /* Evaluate only the predicates not evaluated yet in this run */
+  fsm_preds_t missing = need & ~*done;
+  while (missing) {
+    unsigned int bit = __builtin_ctz(missing);
+    fsm_event_t *pred = &me->preds_list.preds[bit];
+    if (check_event(me, pred)) {
+      *bits |= (fsm_preds_t)1 << bit;
+    }
+    missing &= missing - 1;
+  }
+  *done |= need;
+
+  /* Resolve the transition events with a mask test */
+  if (me->trans_list.trans[index].op == FSM_OP_AND) {
+    return (*bits & need) == need;
+  }
+
+  return (*bits & need) != 0;
+}
+
+static fsm_err_t compile_preds(fsm_t *const me) {
+  fsm_event_t *preds = malloc(FSM_PREDS_MAX * sizeof *preds);
+  fsm_preds_t *masks = calloc(me->trans_list.len ? me->trans_list.len : 1,
+                              sizeof *masks);
+
+  if (preds == NULL || masks == NULL) {
+    free(preds);
+    free(masks);
+    free_preds(me);
+    me->eval_mode = FSM_EVAL_MODE_DEFAULT;
+    return FSM_ERR_NO_MEM;
+  }
+
+  size_t len = 0;
+  for (size_t i = 0; i < me->trans_list.len; i++) {
+    fsm_trans_t *trans = &me->trans_list.trans[i];
+    fsm_event_t *events = trans_events(me, trans);
+    for (size_t j = 0; j < trans_events_len(trans); j++) {
+      fsm_event_t *event = &events[j];
+
+      /* Look for the same predicate in the table */
+      size_t k = 0;
+      while (k < len && !(preds[k].val == event->val &&
+                          preds[k].cmp == event->cmp &&
+                          same_eval(me, &preds[k], event))) {
+        k++;
+      }
+
+      /* Add the predicate if it is new */
+      if (k == len) {
+        if (len == FSM_PREDS_MAX) {
+          free(preds);
+          free(masks);
+          free_preds(me);
+          me->eval_mode = FSM_EVAL_MODE_DEFAULT;
+          return FSM_ERR_FAIL;
+        }
+        preds[len++] = *event;
+      }
+
+      masks[i] |= (fsm_preds_t)1 << k;
+    }
+  }
+
+  /* Replace the previous table */
+  free_preds(me);
+  me->preds_list.preds = preds;
+  me->preds_list.masks = masks;
+  me->preds_list.len = len;
+
+  return FSM_ERR_OK;
+}
+
+static bool memo_hit(fsm_t *const me, fsm_trans_t *trans) {
+  if (!trans->memo.enabled || !trans->memo.valid) {
+    return false;
+  }
+
+  /* The cached result is valid while no input version changed */
+  fsm_event_t *events = trans_events(me, trans);
+  for (size_t i = 0; i < trans_events_len(trans); i++) {
+    if (VERSION_STAMP(event_input(&events[i])->version) != events[i].seen) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void memo_store(fsm_t *const me, fsm_trans_t *trans, bool res) {
+  fsm_event_t *events = trans_events(me, trans);
+  for (size_t i = 0; i < trans_events_len(trans); i++) {
+    events[i].seen = VERSION_STAMP(event_input(&events[i])->version);
+  }
+
+  trans->memo.res = res;
+  trans->memo.valid = true;
+}
+
+#if FSM_PACKED_LAYOUT
+static void drop_memos(fsm_t *const me, uint8_t state) {
+  for (size_t i = 0; i < me->trans_list.len; i++) {
+    if (me->trans_list.trans[i].present_state == state) {
+      me->trans_list.trans[i].memo.valid = false;
+    }
+  }
+}
+#endif
+
+static bool count_expr(const fsm_expr_t *expr, size_t *events,
+                       size_t *timeouts, size_t *code) {
+  if (expr == NULL) {
+    return false;
+  }
+
+  switch (expr->type) {
+    case FSM_EXPR_TYPE_CMP:
+      if (expr->event.val == NULL || expr->event.eval == NULL) {
+        return false;
+      }
+      (*events)++;
+      (*code)++;
+      return true;
+    case FSM_EXPR_TYPE_TIMEOUT:
+      (*timeouts)++;
+      (*code)++;
+      return true;
+    case FSM_EXPR_TYPE_NOT:
+      (*code)++;
+      return count_expr(expr->args.lhs, events, timeouts, code);
+    case FSM_EXPR_TYPE_AND:
+    case FSM_EXPR_TYPE_OR:
+      (*code)++;
+      return count_expr(expr->args.lhs, events, timeouts, code) &&
+             count_expr(expr->args.rhs, events, timeouts, code);
+    default:
+      return false;
+  }
+}
+
+static fsm_err_t emit_expr(fsm_t *const me, fsm_guard_t *guard,
+                           const fsm_expr_t *expr, size_t *events,
+                           size_t *timeouts) {
+  fsm_err_t ret = FSM_ERR_OK;
+  guard_instr_t *instr;
+
+  switch (expr->type) {
+    case FSM_EXPR_TYPE_CMP:
+      ret = set_event(me, &guard->events[*events], expr->event.val, NULL,
+                      expr->event.cmp, (fsm_eval_fn_t){.eval = expr->event.eval},
+                      expr->event.ctx);
+      guard->code[guard->len++] =
+          (guard_instr_t){.op = GUARD_OP_CMP, .arg = (uint8_t)(*events)++};
+      break;
+    case FSM_EXPR_TYPE_TIMEOUT:
+      guard->timeouts[*timeouts] = ms_to_ticks(me, expr->timeout);
+      guard->code[guard->len++] =
+          (guard_instr_t){.op = GUARD_OP_TIMEOUT, .arg = (uint8_t)(*timeouts)++};
+      break;
+    case FSM_EXPR_TYPE_NOT:
+      ret = emit_expr(me, guard, expr->args.lhs, events, timeouts);
+      guard->code[guard->len++] = (guard_instr_t){.op = GUARD_OP_NOT};
+      break;
+    default:
+      /* Evaluate the right side only if the left side doesn't decide */
+      ret = emit_expr(me, guard, expr->args.lhs, events, timeouts);
+      if (ret != FSM_ERR_OK) {
+        break;
+      }
+      instr = &guard->code[guard->len++];
+      instr->op = expr->type == FSM_EXPR_TYPE_AND ? GUARD_OP_JF : GUARD_OP_JT;
+      ret = emit_expr(me, guard, expr->args.rhs, events, timeouts);
+      instr->arg = (uint8_t)guard->len;
+      break;
+  }
+
+  return ret;
+}
+
+static bool eval_guard(fsm_t *const me, const fsm_guard_t *guard,
+                       uint32_t elapsed_ms) {
+  bool acc = true;
+  size_t pc = 0;
+
+  while (pc < guard->len) {
+    guard_instr_t instr = guard->code[pc++];
+    const fsm_event_t *event;
+
+    switch (instr.op) {
+      case GUARD_OP_CMP:
+        event = &guard->events[instr.arg];
+        acc = check_event(me, event);
+        break;
+      case GUARD_OP_TIMEOUT:
+        acc = elapsed_ms >= guard->timeouts[instr.arg];
+        break;
+      case GUARD_OP_NOT:
+        acc = !acc;
+        break;
+      case GUARD_OP_JF:
+        if (!acc) {
+          pc = instr.arg;
+        }
+        break;
+      default:
+        if (acc) {
+          pc = instr.arg;
+        }
+        break;
+    }
+  }
+
+  return acc;
+}
+
+static void schedule_timer(fsm_t *const me, uint64_t now_ticks) {
+  uint32_t ticks_per_ms = me->time64.ticks_per_ms;
+  uint32_t now_ms = (uint32_t)(now_ticks / ticks_per_ms);
+
+  /* Run again as soon as possible to execute the entry action */
+  if (me->current_state != me->prev_state) {
+    fsm_wheel_schedule(me->wheel, me, now_ms);
+    return;
+  }
+
+  /* Look for the earliest timeout not expired yet */
+  uint32_t elapsed = elapsed_ticks(me, now_ticks);
+  uint32_t next = 0;
+  bool found = false;
+
+  /* Timeouts of a table loaded by reference */
+  const fsm_table_t *table = me->table;
+  for (size_t i = 0; table != NULL && i < table->rows_len; i++) {
+    const fsm_table_row_t *row = &table->rows[i];
+    uint32_t timeout = ms_to_ticks(me, row->timeout);
+    if (row->from_state == me->current_state && timeout > elapsed &&
+        (!found || timeout < next)) {
+      next = timeout;
+      found = true;
+    }
+  }
+
+  for (size_t i = 0; i < me->trans_list.len; i++) {
+    fsm_trans_t *trans = &me->trans_list.trans[i];
+    if (trans->present_state != me->current_state) {
+      continue;
+    }
+
+    fsm_guard_t *guard = trans_guard(me, trans);
+    size_t len = guard != NULL ? guard->len : 1;
+    for (size_t j = 0; j < len; j++) {
+      uint32_t timeout;
+      if (guard != NULL) {
+        if (guard->code[j].op != GUARD_OP_TIMEOUT) {
+          continue;
+        }
+        timeout = guard->timeouts[guard->code[j].arg];
+      } else {
+        timeout = trans->timeout;
+      }
+
+      if (timeout > elapsed && (!found || timeout < next)) {
+        next = timeout;
+        found = true;
+      }
+    }
+  }
+
+  /* Round up to the first ms where the timeout is expired */
+  uint32_t next_ms = 0;
+  if (found) {
+    next_ms = (uint32_t)((me->time64.entry + next + ticks_per_ms - 1) /
+                         ticks_per_ms);
+  }
+
+  /* Run when the dwell budget is exceeded to report it */
+  const fsm_budget_t *budget = state_budget(me);
+  if (budget != NULL && budget->dwell_ms && !me->budgets.dwell_reported &&
+      budget->dwell_ms + 1 > now_ms - me->entry_ms) {
+    uint32_t dwell_ms = me->entry_ms + budget->dwell_ms + 1;
+    if (!found || (int32_t)(dwell_ms - next_ms) < 0) {
+      next_ms = dwell_ms;
+      found = true;
+    }
+  }
+
+  if (found) {
+    fsm_wheel_schedule(me->wheel, me, next_ms);
+  } else {
+    fsm_wheel_cancel(me->wheel, me);
+  }
+}
+
+static bool is_running(fsm_t *const me) {
+  return __atomic_load_n(&me->running, __ATOMIC_RELAXED);
+}
+
+static bool owns_trans(fsm_t *const me, const fsm_trans_t *trans) {
+  const fsm_trans_t *base = me->trans_list.trans;
+  return trans >= base && trans < base + me->trans_list.len;
+}
+
+static void publish_state(fsm_t *const me, uint8_t prev_state, uint16_t seq) {
+  uint32_t word = (uint32_t)me->current_state | (uint32_t)prev_state << 8 |
+                  (uint32_t)seq << 16;
+  __atomic_store_n(&me->state_word, word, __ATOMIC_RELEASE);
+}
+
+static fsm_err_t build_observers(fsm_t *const me) {
+  /* The states up to the highest from state filter have their own group */
+  size_t len = 0, entries = 0;
+  for (fsm_observer_t *obs = me->observers.head; obs != NULL; obs = obs->next) {
+    if (obs->from_state != FSM_STATE_ANY && (size_t)obs->from_state >= len) {
+      len = (size_t)obs->from_state + 1;
+    }
+  }
+
+  for (size_t state = 0; state <= len; state++) {
+    for (fsm_observer_t *obs = me->observers.head; obs != NULL;
+         obs = obs->next) {
+      entries += observer_in_group(obs, state, len);
+    }
+  }
+
+  fsm_observer_t **table = NULL;
+  size_t *offsets = NULL;
+
+  if (me->observers.head != NULL) {
+    table = malloc((entries ? entries : 1) * sizeof *table);
+    offsets = malloc((len + 2) * sizeof *offsets);
+
+    if (table == NULL || offsets == NULL) {
+      free(table);
+      free(offsets);
+      return FSM_ERR_NO_MEM;
+    }
+
+    /* Fill the groups in subscription order */
+    size_t pos = 0;
+    for (size_t state = 0; state <= len; state++) {
+      offsets[state] = pos;
+      for (fsm_observer_t *obs = me->observers.head; obs != NULL;
+           obs = obs->next) {
+        if (observer_in_group(obs, state, len)) {
+          table[pos++] = obs;
+        }
+      }
+    }
+    offsets[len + 1] = pos;
+  }
+
+  /* Replace the previous groups */
+  free(me->observers.table);
+  free(me->observers.offsets);
+  me->observers.table = table;
+  me->observers.offsets = offsets;
+  me->observers.len = len;
+
+  return FSM_ERR_OK;
+}
+
+static void notify_observers(fsm_t *const me, uint8_t from_state,
+                             uint8_t to_state) {
+  size_t group = from_state < me->observers.len ? from_state
+                                                : me->observers.len;
+
+  for (size_t i = me->observers.offsets[group];
+       i < me->observers.offsets[group + 1]; i++) {
+    fsm_observer_t *obs = me->observers.table[i];
+    if (obs->to_state == FSM_STATE_ANY || obs->to_state == to_state) {
+      obs->fn(me, from_state, to_state, obs->arg);
+    }
+  }
+}
+
+static bool observer_in_group(const fsm_observer_t *observer, size_t state,
+                              size_t len) {
+  /* The last group has only the observers of any state */
+  if (observer->from_state == FSM_STATE_ANY) {
+    return true;
+  }
+
+  return state < len && (size_t)observer->from_state == state;
+}
+
+static void adopt_definition(fsm_t *const me) {
+  fsm_t *def = __atomic_exchange_n(&me->rcu.pending, NULL, __ATOMIC_ACQUIRE);
+
+  if (def == NULL) {
+    return;
+  }
+
+  swap_definition(me, def);
+
+  /* Translate the states to the new IDs, an entry action still pending stays
+  pending */
+  bool entered = me->current_state == me->prev_state;
+  uint8_t prev_state = (uint8_t)(me->state_word >> 8);
+  uint16_t seq = (uint16_t)(me->state_word >> 16);
+
+  if (me->current_state < def->rcu.map_len) {
+    me->current_state = def->rcu.map[me->current_state];
+  }
+
+  if (prev_state < def->rcu.map_len) {
+    prev_state = def->rcu.map[prev_state];
+  }
+
+  me->prev_state = entered ? me->current_state : me->current_state - 1;
+  publish_state(me, prev_state, seq);
+
+  if (me->fleet != NULL) {
+    fsm_fleet_update(me->fleet, me);
+  }
+
+  /* No one else uses the old definition after this point */
+  retire_definition(me, def);
+}
+
+static void swap_definition(fsm_t *const a, fsm_t *const b) {
+  fsm_t tmp;
+
+  tmp.trans_list = a->trans_list;
+  tmp.actions_list = a->actions_list;
+  tmp.table = a->table;
+  tmp.eval_mode = a->eval_mode;
+  tmp.preds_list = a->preds_list;
+  tmp.budgets.budgets = a->budgets.budgets;
+  tmp.budgets.len = a->budgets.len;
+  tmp.async.actions = a->async.actions;
+  tmp.async.len = a->async.len;
+#if FSM_PACKED_LAYOUT
+  tmp.events_pool = a->events_pool;
+  tmp.evals_pool = a->evals_pool;
+  tmp.trans_actions_pool = a->trans_actions_pool;
+  tmp.guards_pool = a->guards_pool;
+#endif
+
+  a->trans_list = b->trans_list;
+  a->actions_list = b->actions_list;
+  a->table = b->table;
+  a->eval_mode = b->eval_mode;
+  a->preds_list = b->preds_list;
+  a->budgets.budgets = b->budgets.budgets;
+  a->budgets.len = b->budgets.len;
+  a->async.actions = b->async.actions;
+  a->async.len = b->async.len;
+#if FSM_PACKED_LAYOUT
+  a->events_pool = b->events_pool;
+  a->evals_pool = b->evals_pool;
+  a->trans_actions_pool = b->trans_actions_pool;
+  a->guards_pool = b->guards_pool;
+#endif
+
+  b->trans_list = tmp.trans_list;
+  b->actions_list = tmp.actions_list;
+  b->table = tmp.table;
+  b->eval_mode = tmp.eval_mode;
+  b->preds_list = tmp.preds_list;
+  b->budgets.budgets = tmp.budgets.budgets;
+  b->budgets.len = tmp.budgets.len;
+  b->async.actions = tmp.async.actions;
+  b->async.len = tmp.async.len;
+#if FSM_PACKED_LAYOUT
+  b->events_pool = tmp.events_pool;
+  b->evals_pool = tmp.evals_pool;
+  b->trans_actions_pool = tmp.trans_actions_pool;
+  b->guards_pool = tmp.guards_pool;
+#endif
+}
+
+static void retire_definition(fsm_t *const me, fsm_t *def) {
+  /* Lock-free push, the instance and the publisher can retire at the same
+  time */
+  fsm_t *head = __atomic_load_n(&me->rcu.retired, __ATOMIC_RELAXED);
+  do {
+    def->rcu.next = head;
+  } while (!__atomic_compare_exchange_n(&me->rcu.retired, &head, def, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static void free_definition(fsm_t *const me) {
+#if !FSM_PACKED_LAYOUT
+  for (size_t i = 0; i < me->trans_list.len; i++) {
+    free(me->trans_list.trans[i].events_list.events);
+    free(me->trans_list.trans[i].guard);
+  }
+#endif
+
+  free(me->trans_list.trans);
+  me->trans_list.trans = NULL;
+  me->trans_list.len = 0;
+  free(me->actions_list.actions);
+  me->actions_list.actions = NULL;
+  me->actions_list.len = 0;
+  me->table = NULL; /* Owned by the application */
+  free_preds(me);
+  me->eval_mode = FSM_EVAL_MODE_DEFAULT;
+
+#if FSM_PACKED_LAYOUT
+  for (size_t i = 0; i < me->guards_pool.len; i++) {
+    free(me->guards_pool.guards[i]);
+  }
+
+  free(me->events_pool.events);
+  me->events_pool.events = NULL;
+  me->events_pool.len = 0;
+  free(me->evals_pool.evals);
+  me->evals_pool.evals = NULL;
+  me->evals_pool.len = 0;
+  free(me->trans_actions_pool.actions);
+  me->trans_actions_pool.actions = NULL;
+  me->trans_actions_pool.len = 0;
+  free(me->guards_pool.guards);
+  me->guards_pool.guards = NULL;
+  me->guards_pool.len = 0;
+#endif
+}
+
+static fsm_event_t *trans_events(fsm_t *const me, const fsm_trans_t *trans) {
+#if FSM_PACKED_LAYOUT
+  return &me->events_pool.events[trans->events];
+#else
+  (void)me;
+  return trans->events_list.events;
+#endif
+}
+
+static size_t trans_events_len(const fsm_trans_t *trans) {
+#if FSM_PACKED_LAYOUT
+  return trans->events_len;
+#else
+  return trans->events_list.len;
+#endif
+}
+
+#if FSM_PACKED_LAYOUT
+static bool shares_events(fsm_t *const me, const fsm_trans_t *trans) {
+  size_t first = trans->events;
+  size_t end = first + trans->events_len;
+
+  /* Other events overlap the events of the transition or the position of
+  the new one */
+  const fsm_trans_t *base = me->trans_list.trans;
+  for (size_t i = 0; i < me->trans_list.len; i++) {
+    if (&base[i] != trans && base[i].events_len &&
+        base[i].events < end && base[i].events + base[i].events_len > first) {
+      return true;
+    }
+  }
+
+  return false;
+}
+#endif
+
+static fsm_action_t *trans_action(fsm_t *const me, const fsm_trans_t *trans) {
+#if FSM_PACKED_LAYOUT
+  if (trans->action == FSM_SLOT_NONE) {
+    return NULL;
+  }
+  return &me->trans_actions_pool.actions[trans->action];
+#else
+  (void)me;
+  return (fsm_action_t *)&trans->action;
+#endif
+}
+
+static fsm_guard_t *trans_guard(fsm_t *const me, const fsm_trans_t *trans) {
+#if FSM_PACKED_LAYOUT
+  if (trans->guard == FSM_SLOT_NONE) {
+    return NULL;
+  }
+  return me->guards_pool.guards[trans->guard];
+#else
+  (void)me;
+  return trans->guard;
+#endif
+}
+
+static fsm_err_t set_trans_action(fsm_t *const me, fsm_trans_t *trans,
+                                  fsm_action_t action) {
+#if FSM_PACKED_LAYOUT
+  if (action.fn == NULL) {
+    trans->action = FSM_SLOT_NONE;
+    return FSM_ERR_OK;
+  }
+
+  /* Reuse the slot of the same action */
+  size_t slot = 0;
+  while (slot < me->trans_actions_pool.len &&
+         !(me->trans_actions_pool.actions[slot].fn == action.fn &&
+           me->trans_actions_pool.actions[slot].arg == action.arg &&
+           me->trans_actions_pool.actions[slot].ctx == action.ctx)) {
+    slot++;
+  }
+
+  if (slot == me->trans_actions_pool.len) {
+    if (slot == FSM_SLOT_NONE) {
+      return FSM_ERR_NO_MEM;
+    }
+
+    fsm_action_t *ptr = fsm_array_grow(me->trans_actions_pool.actions, slot,
+                                       slot + 1, sizeof *ptr);
+    if (ptr == NULL) {
+      return FSM_ERR_NO_MEM;
+    }
+
+    ptr[slot] = action;
+    me->trans_actions_pool.actions = ptr;
+    me->trans_actions_pool.len++;
+  }
+
+  trans->action = (uint8_t)slot;
+#else
+  (void)me;
+  trans->action = action;
+#endif
+
+  return FSM_ERR_OK;
+}
+
+static fsm_err_t set_trans_guard(fsm_t *const me, fsm_trans_t *trans,
+                                 fsm_guard_t *guard) {
+#if FSM_PACKED_LAYOUT
+  /* Replace the guard in its slot */
+  if (trans->guard != FSM_SLOT_NONE) {
+    free(me->guards_pool.guards[trans->guard]);
+    me->guards_pool.guards[trans->guard] = guard;
+    if (guard == NULL) {
+      trans->guard = FSM_SLOT_NONE;
+    }
+    return FSM_ERR_OK;
+  }
+
+  if (guard == NULL) {
+    return FSM_ERR_OK;
+  }
+
+  /* Reuse a free slot or add a new one */
+  size_t slot = 0;
+  while (slot < me->guards_pool.len && me->guards_pool.guards[slot] != NULL) {
+    slot++;
+  }
+
+  if (slot == me->guards_pool.len) {
+    if (slot == FSM_SLOT_NONE) {
+      return FSM_ERR_NO_MEM;
+    }
+
+    fsm_guard_t **ptr =
+        fsm_array_grow(me->guards_pool.guards, slot, slot + 1, sizeof *ptr);
+    if (ptr == NULL) {
+      return FSM_ERR_NO_MEM;
+    }
+
+    me->guards_pool.guards = ptr;
+    me->guards_pool.len++;
+  }
+
+  me->guards_pool.guards[slot] = guard;
+  trans->guard = (uint8_t)slot;
+#else
+  (void)me;
+  free(trans->guard);
+  trans->guard = guard;
+#endif
+
+  return FSM_ERR_OK;
+}
+
+static fsm_eval_fn_t event_eval(fsm_t *const me, const fsm_event_t *event) {
+#if FSM_PACKED_LAYOUT
+  return me->evals_pool.evals[event->eval];
+#else
+  (void)me;
+  return (fsm_eval_fn_t){.eval = event->eval};
+#endif
+}
+
+static bool check_event(fsm_t *const me, const fsm_event_t *event) {
+  fsm_eval_fn_t fn = event_eval(me, event);
+
+  if (event->ctx) {
+    return fn.eval_ctx(me->ctx, *event->val, event->cmp);
+  }
+
+  return fn.eval(*event->val, event->cmp);
+}
+
+static bool same_eval(fsm_t *const me, const fsm_event_t *a,
+                      const fsm_event_t *b) {
+  /* Both kinds of functions share the storage */
+  return a->ctx == b->ctx && event_eval(me, a).eval == event_eval(me, b).eval;
+}
+
+static fsm_input_t *event_input(const fsm_event_t *event) {
+#if FSM_PACKED_LAYOUT
+  if (!event->input) {
+    return NULL;
+  }
+  return (fsm_input_t *)((char *)event->val - offsetof(fsm_input_t, val));
+#else
+  return event->input;
+#endif
+}
+
+static fsm_err_t set_event(fsm_t *const me, fsm_event_t *event, int *val,
+                           fsm_input_t *input, int cmp, fsm_eval_fn_t eval,
+                           bool ctx) {
+  event->val = val;
+  event->cmp = cmp;
+  event->seen = 0;
+  event->ctx = ctx;
+
+#if FSM_PACKED_LAYOUT
+  event->input = input != NULL;
+
+  /* Reuse the slot of the same evaluation function */
+  size_t slot = 0;
+  while (slot < me->evals_pool.len &&
+         me->evals_pool.evals[slot].eval != eval.eval) {
+    slot++;
+  }
+
+  if (slot == me->evals_pool.len) {
+    if (slot == FSM_SLOT_NONE) {
+      return FSM_ERR_NO_MEM;
+    }
+
+    fsm_eval_fn_t *ptr =
+        fsm_array_grow(me->evals_pool.evals, slot, slot + 1, sizeof *ptr);
+    if (ptr == NULL) {
+      return FSM_ERR_NO_MEM;
+    }
+
+    ptr[slot] = eval;
+    me->evals_pool.evals = ptr;
+    me->evals_pool.len++;
+  }
+
+  event->eval = (uint8_t)slot;
+#else
+  (void)me;
+  event->eval = eval.eval;
+  event->input = input;
+#endif
+
+  return FSM_ERR_OK;
+}
+
+static fsm_err_t check_table(fsm_t *const me, const fsm_table_t *table) {
+  if ((table->rows == NULL && table->rows_len) ||
+      (table->events == NULL && table->events_len) ||
+      (table->states == NULL && table->states_len)) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  for (size_t i = 0; i < table->rows_len; i++) {
+    const fsm_table_row_t *row = &table->rows[i];
+    if (row->from_state == row->next_state || row->op < 0 ||
+        row->op >= FSM_OP_MAX ||
+        (size_t)row->events + row->events_len > table->events_len) {
+      return FSM_ERR_INVALID_PARAM;
+    }
+
+    /* Timeouts need a time source */
+    if (row->timeout && me->get_ms == NULL && me->time64.get_ticks == NULL) {
+      return FSM_ERR_INVALID_PARAM;
+    }
+  }
+
+  for (size_t i = 0; i < table->events_len; i++) {
+    if (table->events[i].val == NULL || table->events[i].eval == NULL) {
+      return FSM_ERR_INVALID_PARAM;
+    }
+  }
+
+  return FSM_ERR_OK;
+}
+
+static fsm_err_t copy_table(fsm_t *const me, const fsm_table_t *table) {
+  /* Allocate each table once with the capacity of fsm_array_grow(), so the
+  definition can still be extended */
+  if (table->rows_len) {
+    me->trans_list.trans = fsm_array_grow(NULL, 0, table->rows_len,
+                                          sizeof *me->trans_list.trans);
+    if (me->trans_list.trans == NULL) {
+      return FSM_ERR_NO_MEM;
+    }
+  }
+
+  if (table->states_len) {
+    me->actions_list.actions = fsm_array_grow(NULL, 0, table->states_len,
+                                              sizeof *me->actions_list.actions);
+    if (me->actions_list.actions == NULL) {
+      return FSM_ERR_NO_MEM;
+    }
+
+    memcpy(me->actions_list.actions, table->states,
+           table->states_len * sizeof *me->actions_list.actions);
+    me->actions_list.len = table->states_len;
+  }
+
+#if FSM_PACKED_LAYOUT
+  /* The events keep their indices in the pool */
+  if (table->events_len) {
+    if (table->events_len >= UINT16_MAX) {
+      return FSM_ERR_NO_MEM;
+    }
+
+    me->events_pool.events = fsm_array_grow(NULL, 0, table->events_len,
+                                            sizeof *me->events_pool.events);
+    if (me->events_pool.events == NULL) {
+      return FSM_ERR_NO_MEM;
+    }
+
+    for (size_t i = 0; i < table->events_len; i++) {
+      const fsm_table_event_t *event = &table->events[i];
+      fsm_err_t ret = set_event(me, &me->events_pool.events[i], event->val,
+                                NULL, event->cmp,
+                                (fsm_eval_fn_t){.eval = event->eval}, false);
+      if (ret != FSM_ERR_OK) {
+        return ret;
+      }
+    }
+
+    me->events_pool.len = table->events_len;
+  }
+#endif
+
+  for (size_t i = 0; i < table->rows_len; i++) {
+    const fsm_table_row_t *row = &table->rows[i];
+    fsm_trans_t *trans = &me->trans_list.trans[i];
+
+#if FSM_PACKED_LAYOUT
+    trans->events = row->events;
+    trans->events_len = row->events_len;
+    trans->action = FSM_SLOT_NONE;
+    trans->guard = FSM_SLOT_NONE;
+#else
+    trans->events_list.events = NULL;
+    trans->events_list.len = 0;
+    trans->guard = NULL;
+#endif
+    trans->present_state = row->from_state;
+    trans->next_state = row->next_state;
+    trans->op = row->op;
+    trans->timeout = ms_to_ticks(me, row->timeout);
+    trans->memo.enabled = false;
+    trans->memo.valid = false;
+    trans->memo.res = false;
+    me->trans_list.len++;
+
+#if !FSM_PACKED_LAYOUT
+    if (row->events_len) {
+      fsm_event_t *events =
+          fsm_array_grow(NULL, 0, row->events_len, sizeof *events);
+      if (events == NULL) {
+        return FSM_ERR_NO_MEM;
+      }
+
+      trans->events_list.events = events;
+      trans->events_list.len = row->events_len;
+
+      for (size_t j = 0; j < row->events_len; j++) {
+        const fsm_table_event_t *event = &table->events[row->events + j];
+        fsm_err_t ret =
+            set_event(me, &events[j], event->val, NULL, event->cmp,
+                      (fsm_eval_fn_t){.eval = event->eval}, false);
+        if (ret != FSM_ERR_OK) {
+          return ret;
+        }
+      }
+    }
+#endif
+
+    fsm_err_t ret = set_trans_action(
+        me, trans, (fsm_action_t){.fn = row->fn, .arg = row->arg});
+    if (ret != FSM_ERR_OK) {
+      return ret;
+    }
+  }
+
+  return FSM_ERR_OK;
+}
+
+static uint8_t table_next_state(fsm_t *const me, uint32_t elapsed,
+                                uint32_t *enabled_at) {
+  const fsm_table_t *table = me->table;
+
+  *enabled_at = elapsed;
+
+  /* Same evaluation as the transitions, reading the rows in place */
+  for (size_t i = 0; i < table->rows_len; i++) {
+    const fsm_table_row_t *row = &table->rows[i];
+    if (row->from_state != me->current_state) {
+      continue;
+    }
+
+    uint32_t timeout = ms_to_ticks(me, row->timeout);
+    bool cmp_res = row->op == FSM_OP_AND;
+
+    for (size_t j = 0; j < row->events_len; j++) {
+      const fsm_table_event_t *event = &table->events[row->events + j];
+      if (row->op == FSM_OP_AND) {
+        cmp_res &= event->eval(*event->val, event->cmp);
+      } else {
+        cmp_res |= event->eval(*event->val, event->cmp);
+      }
+    }
+
+    bool timeout_res = timeout ? elapsed >= timeout : row->op == FSM_OP_AND;
+    bool res = row->op == FSM_OP_AND ? cmp_res && timeout_res
+                                     : cmp_res || timeout_res;
+
+    if (!row->events_len && !timeout) {
+      res = true;
+    } else if (res && timeout &&
+               (row->op == FSM_OP_AND ? !row->events_len : !cmp_res)) {
+      *enabled_at = timeout;
+    }
+
+    if (res) {
+      fsm_action_t action = {.fn = row->fn, .arg = row->arg};
+      call_action(me, &action, FSM_ACTION_TYPE_TRANS);
+      return row->next_state;
+    }
+  }
+
+  return me->current_state;
+}
+
+static bool start_async(fsm_t *const me) {
+  if (me->current_state >= me->async.len ||
+      me->async.actions[me->current_state].fn == NULL) {
+    return false;
+  }
+
+  /* New operation ID, 0 and ASYNC_COMPLETING are reserved */
+  uint32_t id = me->async.seq + 1;
+  if (id == 0 || id == ASYNC_COMPLETING) {
+    id = 1;
+  }
+  me->async.seq = id;
+
+  /* Pending before the action starts, it can complete at once */
+  __atomic_store_n(&me->async.pending, id, __ATOMIC_RELEASE);
+
+  fsm_async_action_t *action = &me->async.actions[me->current_state];
+  if (!action->fn((fsm_async_t){.fsm = me, .id = id}, action->arg)) {
+    /* Finished inside the action without completing the operation */
+    uint32_t expected = id;
+    __atomic_compare_exchange_n(&me->async.pending, &expected, 0, false,
+                                __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+  }
+
+  return async_pending(me);
+}
+
+static bool async_pending(fsm_t *const me) {
+  return __atomic_load_n(&me->async.pending, __ATOMIC_ACQUIRE) != 0;
+}
+
+static void abort_async(fsm_t *const me) {
+  /* A late completion finds other value and fails, an operation already
+  taken by its completion finishes normally */
+  uint32_t id = __atomic_load_n(&me->async.pending, __ATOMIC_RELAXED);
+  if (id != 0 && id != ASYNC_COMPLETING) {
+    __atomic_compare_exchange_n(&me->async.pending, &id, 0, false,
+                                __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+  }
+}
+
+static uint8_t timeout_next_state(fsm_t *const me, uint32_t elapsed,
+                                  uint32_t *enabled_at) {
+  /* Only the transitions enabled by their timeout alone, the events wait for
+  the result of the operation */
+  const fsm_table_t *table = me->table;
+  for (size_t i = 0; table != NULL && i < table->rows_len; i++) {
+    const fsm_table_row_t *row = &table->rows[i];
+    uint32_t timeout = ms_to_ticks(me, row->timeout);
+    if (row->from_state == me->current_state && timeout &&
+        elapsed >= timeout &&
+        (row->op == FSM_OP_OR || !row->events_len)) {
+      fsm_action_t action = {.fn = row->fn, .arg = row->arg};
+      *enabled_at = timeout;
+      call_action(me, &action, FSM_ACTION_TYPE_TRANS);
+      return row->next_state;
+    }
+  }
+
+  for (size_t i = 0; i < me->trans_list.len; i++) {
+    fsm_trans_t *trans = &me->trans_list.trans[i];
+    if (trans->present_state == me->current_state &&
+        trans_guard(me, trans) == NULL && trans->timeout &&
+        elapsed >= trans->timeout &&
+        (trans->op == FSM_OP_OR || !trans_events_len(trans))) {
+      *enabled_at = trans->timeout;
+      call_action(me, trans_action(me, trans), FSM_ACTION_TYPE_TRANS);
+      return trans->next_state;
+    }
+  }
+
+  return me->current_state;
+}
+
+static size_t guard_size(const fsm_guard_t *guard) {
+  if (guard == NULL) {
+    return 0;
+  }
+
+  /* The operands and the code follow the header in the same block */
+  return (size_t)((const char *)(guard->code + guard->len) -
+                  (const char *)guard);
+}
+
+static void free_preds(fsm_t *const me) {
+  free(me->preds_list.preds);
+  free(me->preds_list.masks);
+  me->preds_list.preds = NULL;
+  me->preds_list.masks = NULL;
+  me->preds_list.len = 0;
+}
+
+static fsm_err_t add_event(fsm_t *const me, fsm_trans_t *trans, int *val,
+                           fsm_input_t *input, int cmp, fsm_eval_fn_t eval,
+                           bool ctx) {
+  /* Check if the FSM instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the FSM instance is running */
+  if (is_running(me)) {
+    return FSM_ERR_BUSY;
+  }
+
+  /* Check if the transition pointer is valid */
+  if (trans == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the event value pointer is valid */
+  if (val == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the evaluation function is valid */
+  if (eval.eval == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the transition is part of the FSM */
+  if (!owns_trans(me, trans)) {
+    return FSM_ERR_FAIL;
+  }
+
+#if FSM_PACKED_LAYOUT
+  /* Set the new event before the pool changes, so a full evaluation
+  functions pool leaves the transition untouched */
+  fsm_event_t event;
+  fsm_err_t ret = set_event(me, &event, val, input, cmp, eval, ctx);
+  if (ret != FSM_ERR_OK) {
+    return ret;
+  }
+
+  /* The events of a loaded table can be shared by several transitions, copy
+  them to the end of the pool before writing */
+  bool shared = shares_events(me, trans);
+  size_t add = shared ? trans->events_len + 1u : 1u;
+
+  /* Check if the indices can address the new event */
+  if (trans->events_len == UINT8_MAX ||
+      me->events_pool.len + add > UINT16_MAX) {
+    return FSM_ERR_NO_MEM;
+  }
+
+  /* Allocate memory for the new event in the pool and check */
+  fsm_event_t *ptr = fsm_array_grow(me->events_pool.events, me->events_pool.len,
+                                    me->events_pool.len + add, sizeof *ptr);
+
+  if (ptr == NULL) {
+    return FSM_ERR_NO_MEM;
+  }
+
+  me->events_pool.events = ptr;
+
+  if (shared) {
+    memcpy(&ptr[me->events_pool.len], &ptr[trans->events],
+           trans->events_len * sizeof *ptr);
+    trans->events = (uint16_t)me->events_pool.len;
+    me->events_pool.len += trans->events_len;
+  }
+
+  /* The events of each transition are contiguous, make room after the last
+  event of the transition and move the following transitions */
+  size_t pos = trans->events + trans->events_len;
+  memmove(&ptr[pos + 1], &ptr[pos],
+          (me->events_pool.len - pos) * sizeof *ptr);
+  me->events_pool.len++;
+
+  fsm_trans_t *base = me->trans_list.trans;
+  for (size_t i = 0; i < me->trans_list.len; i++) {
+    if (&base[i] != trans && base[i].events >= pos) {
+      base[i].events++;
+    }
+  }
+
+  ptr[pos] = event;
+  trans->events_len++;
+#else
+  /* Allocate memory for the new event and check */
+  fsm_event_t *ptr =
+      fsm_array_grow(trans->events_list.events, trans->events_list.len,
+                     trans->events_list.len + 1, sizeof *ptr);
+
+  if (ptr == NULL) {
+    return FSM_ERR_NO_MEM;
+  }
+
+  /* Assign the reallocated memory and add 1 to len */
+  trans->events_list.events = ptr;
+  trans->events_list.len++;
+
+  /* Set the values for the new event element */
+  size_t index = trans->events_list.len - 1;
+  fsm_err_t ret =
+      set_event(me, &trans->events_list.events[index], val, input, cmp, eval,
+                ctx);
+#endif
+
+  if (ret != FSM_ERR_OK) {
+    return ret;
+  }
+
+  /* Drop the predicates table, the next fsm_run() builds it again */
+  free_preds(me);
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
 /***************************** END OF FILE ************************************/
@@ -0,0 +1,84 @@
+/**
+ ******************************************************************************
+ * @file           : fsm_array.h
+ * @author         : Mauricio Barroso Benavides
+ * @date           : Oct 18, 2026
+ * @brief          : This file contains the function prototypes of the
+ *                   array helpers shared by the FSM modules
+ ******************************************************************************
+ * @attention
+ *
+ * MIT License
+ *
+ * Copyright (c) 2026 Mauricio Barroso Benavides
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef FSM_ARRAY_H_
+#define FSM_ARRAY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stddef.h>
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+/**
+ * @brief Function to get the capacity allocated for an array, the next power
+ *        of 2 of its length.
+ *
+ * @param len : Number of elements of the array
+ *
+ * @return Number of elements allocated, 0 for an empty array
+ */
+size_t fsm_array_capacity(size_t len);
+
+/**
+ * @brief Function to grow an array to a new length. The capacity doubles, so
+ *        adding the elements one by one reallocates only log2(len) times.
+ *
+ * @param ptr     : Pointer to the array, NULL to allocate a new one
+ * @param len     : Current number of elements
+ * @param new_len : New number of elements
+ * @param size    : Size of an element
+ *
+ * @return Pointer to the array, which can be moved, or NULL if it can't be
+ *         reallocated and ptr is still valid
+ */
+void *fsm_array_grow(void *ptr, size_t len, size_t new_len, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FSM_ARRAY_H_ */
+
+/***************************** END OF FILE ************************************/
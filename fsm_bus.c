@@ -0,0 +1,478 @@
+/**
+ ******************************************************************************
+ * @file           : fsm_bus.c
+ * @author         : Mauricio Barroso Benavides
+ * @date           : Oct 18, 2026
+ * @brief          : This file provides code for the configuration and control
+ *                   of the FSM event bus
+ ******************************************************************************
+ * @attention
+ *
+ * MIT License
+ *
+ * Copyright (c) 2026 Mauricio Barroso Benavides
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm_bus.h"
+#include "fsm_array.h"
+
+#include <string.h>
+
+/* External variables --------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private macro -------------------------------------------------------------*/
+#define RANK_DELIVERED SIZE_MAX /* Rank of the events already delivered */
+#define NO_EVENT       SIZE_MAX /* End of the events queued for an instance */
+
+/* Private function prototypes -----------------------------------------------*/
+static fsm_err_t sort_nodes(fsm_bus_t *const me);
+static size_t deliver(fsm_bus_t *const me, size_t rank);
+static void enqueue(fsm_bus_t *const me, size_t index);
+static fsm_bus_mark_t *find_mark(fsm_bus_t *const me, const fsm_input_t *input);
+static void compact(fsm_bus_t *const me);
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Exported functions --------------------------------------------------------*/
+/**
+ * @brief Function to initialize an event bus.
+ */
+fsm_err_t fsm_bus_init(fsm_bus_t *const me, size_t size) {
+  /* Check if the bus instance is valid */
+  if (me == NULL || size == 0) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Allocate memory for the events and the marks of their inputs and check */
+  me->queue.events = malloc(size * sizeof *me->queue.events);
+  me->delivered.size = fsm_array_capacity(size + 1);
+  me->delivered.marks =
+      calloc(me->delivered.size, sizeof *me->delivered.marks);
+
+  if (me->queue.events == NULL || me->delivered.marks == NULL) {
+    free(me->queue.events);
+    free(me->delivered.marks);
+    me->queue.events = NULL;
+    me->delivered.marks = NULL;
+    return FSM_ERR_NO_MEM;
+  }
+
+  /* Set default values */
+  me->queue.len = 0;
+  me->queue.size = size;
+  me->nodes.fsms = NULL;
+  me->nodes.pending = NULL;
+  me->nodes.len = 0;
+  me->edges.edges = NULL;
+  me->edges.len = 0;
+  me->delivered.pass = 0;
+  me->dropped = 0;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to deinitialize an event bus.
+ */
+fsm_err_t fsm_bus_deinit(fsm_bus_t *const me) {
+  /* Check if the bus instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  for (size_t i = 0; i < me->nodes.len; i++) {
+    me->nodes.fsms[i]->bus = NULL;
+  }
+
+  free(me->queue.events);
+  free(me->nodes.fsms);
+  free(me->nodes.pending);
+  free(me->edges.edges);
+  free(me->delivered.marks);
+  me->queue.events = NULL;
+  me->queue.len = 0;
+  me->queue.size = 0;
+  me->nodes.fsms = NULL;
+  me->nodes.pending = NULL;
+  me->nodes.len = 0;
+  me->edges.edges = NULL;
+  me->edges.len = 0;
+  me->delivered.marks = NULL;
+  me->delivered.size = 0;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to add a FSM instance to an event bus.
+ */
+fsm_err_t fsm_bus_add(fsm_bus_t *const me, fsm_t *fsm) {
+  /* Check if the bus and FSM instances are valid */
+  if (me == NULL || fsm == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* The queued events refer to the current order */
+  if (me->queue.len) {
+    return FSM_ERR_BUSY;
+  }
+
+  /* Check if the FSM instance was already added to a bus */
+  if (fsm->bus != NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Allocate memory for the new instance and check */
+  fsm_t **fsms = fsm_array_grow(me->nodes.fsms, me->nodes.len,
+                                me->nodes.len + 1, sizeof *fsms);
+
+  if (fsms == NULL) {
+    return FSM_ERR_NO_MEM;
+  }
+
+  me->nodes.fsms = fsms;
+
+  fsm_bus_list_t *pending = fsm_array_grow(me->nodes.pending, me->nodes.len,
+                                           me->nodes.len + 1, sizeof *pending);
+
+  if (pending == NULL) {
+    return FSM_ERR_NO_MEM;
+  }
+
+  me->nodes.pending = pending;
+
+  /* An instance without connections can run at any position */
+  fsms[me->nodes.len] = fsm;
+  pending[me->nodes.len].head = NO_EVENT;
+  pending[me->nodes.len].tail = NO_EVENT;
+  fsm->bus = me;
+  fsm->bus_rank = me->nodes.len;
+  me->nodes.len++;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to remove a FSM instance from an event bus.
+ */
+fsm_err_t fsm_bus_remove(fsm_bus_t *const me, fsm_t *fsm) {
+  /* Check if the bus and FSM instances are valid */
+  if (me == NULL || fsm == NULL || fsm->bus != me) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  size_t rank = fsm->bus_rank;
+
+  /* Drop the connections of the instance */
+  size_t len = 0;
+  for (size_t i = 0; i < me->edges.len; i++) {
+    if (me->edges.edges[i].from != fsm && me->edges.edges[i].to != fsm) {
+      me->edges.edges[len++] = me->edges.edges[i];
+    }
+  }
+
+  me->edges.len = len;
+
+  /* Drop the events queued for the instance, the following ones move down a
+  position with their targets */
+  for (size_t i = 0; i < me->queue.len; i++) {
+    fsm_bus_event_t *event = &me->queue.events[i];
+    if (event->rank == rank) {
+      event->rank = RANK_DELIVERED;
+    } else if (event->rank != RANK_DELIVERED && event->rank > rank) {
+      event->rank--;
+    }
+  }
+
+  /* Without the instance and its connections the order is still topological,
+  so the instances after it only move down a position */
+  for (size_t i = rank + 1; i < me->nodes.len; i++) {
+    me->nodes.fsms[i - 1] = me->nodes.fsms[i];
+    me->nodes.fsms[i - 1]->bus_rank = i - 1;
+  }
+
+  me->nodes.len--;
+  fsm->bus = NULL;
+  compact(me);
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to connect two FSM instances of an event bus.
+ */
+fsm_err_t fsm_bus_connect(fsm_bus_t *const me, fsm_t *from, fsm_t *to) {
+  /* Check if the bus and FSM instances are valid */
+  if (me == NULL || from == NULL || to == NULL || from == to) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* The queued events refer to the current order */
+  if (me->queue.len) {
+    return FSM_ERR_BUSY;
+  }
+
+  /* Check if the FSM instances were added */
+  if (from->bus != me || to->bus != me) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Allocate memory for the new connection and check */
+  fsm_bus_edge_t *edges = fsm_array_grow(me->edges.edges, me->edges.len,
+                                         me->edges.len + 1, sizeof *edges);
+
+  if (edges == NULL) {
+    return FSM_ERR_NO_MEM;
+  }
+
+  edges[me->edges.len].from = from;
+  edges[me->edges.len].to = to;
+  me->edges.edges = edges;
+  me->edges.len++;
+
+  /* Sort the instances again, without the connection if it can't be done */
+  fsm_err_t ret = sort_nodes(me);
+
+  if (ret != FSM_ERR_OK) {
+    me->edges.len--;
+  }
+
+  return ret;
+}
+
+/**
+ * @brief Function to emit an event to a FSM instance.
+ */
+fsm_err_t fsm_bus_emit(fsm_bus_t *const me, fsm_t *target, fsm_input_t *input,
+                       int val) {
+  /* Check if the bus instance, the target and the input are valid */
+  if (me == NULL || target == NULL || input == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the target was added */
+  if (target->bus != me) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  size_t rank = target->bus_rank;
+
+  /* Check if there is a free event */
+  if (me->queue.len == me->queue.size) {
+    me->dropped++;
+    return FSM_ERR_NO_MEM;
+  }
+
+  fsm_bus_event_t *event = &me->queue.events[me->queue.len];
+  event->input = input;
+  event->val = val;
+  event->rank = rank;
+  enqueue(me, me->queue.len++);
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to run one pass of the FSM instances of an event bus.
+ */
+fsm_err_t fsm_bus_run(fsm_bus_t *const me, size_t *delivered) {
+  /* Check if the bus instance is valid */
+  if (me == NULL || me->queue.events == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  uint32_t dropped = me->dropped;
+  size_t count = 0;
+
+  /* New pass, the marks of the previous ones are free */
+  if (++me->delivered.pass == 0) {
+    memset(me->delivered.marks, 0,
+           me->delivered.size * sizeof *me->delivered.marks);
+    me->delivered.pass = 1;
+  }
+
+  /* The events emitted by each instance are queued after the ones it got, and
+  delivered when their targets, later in the order, run */
+  for (size_t rank = 0; rank < me->nodes.len; rank++) {
+    if (me->nodes.pending[rank].head != NO_EVENT) {
+      count += deliver(me, rank);
+    }
+
+    fsm_run(me->nodes.fsms[rank]);
+  }
+
+  compact(me);
+
+  if (delivered != NULL) {
+    *delivered = count;
+  }
+
+  return me->dropped != dropped ? FSM_ERR_NO_MEM : FSM_ERR_OK;
+}
+
+/* Private functions ---------------------------------------------------------*/
+static fsm_err_t sort_nodes(fsm_bus_t *const me) {
+  size_t len = me->nodes.len;
+  size_t *degree = calloc(len, sizeof *degree);
+  fsm_t **order = fsm_array_grow(NULL, 0, len, sizeof *order);
+
+  if (degree == NULL || order == NULL) {
+    free(degree);
+    free(order);
+    return FSM_ERR_NO_MEM;
+  }
+
+  /* Count the sources of each instance */
+  for (size_t i = 0; i < me->edges.len; i++) {
+    degree[me->edges.edges[i].to->bus_rank]++;
+  }
+
+  /* Take the first instance without pending sources, keeping the previous
+  order between the instances that don't depend on each other */
+  size_t sorted = 0;
+  while (sorted < len) {
+    size_t i = 0;
+    while (i < len && degree[i] != 0) {
+      i++;
+    }
+
+    if (i == len) {
+      break;
+    }
+
+    degree[i] = SIZE_MAX;
+    order[sorted++] = me->nodes.fsms[i];
+
+    for (size_t j = 0; j < me->edges.len; j++) {
+      if (me->edges.edges[j].from == me->nodes.fsms[i]) {
+        degree[me->edges.edges[j].to->bus_rank]--;
+      }
+    }
+  }
+
+  free(degree);
+
+  /* The instances left are in a cycle */
+  if (sorted < len) {
+    free(order);
+    return FSM_ERR_FAIL;
+  }
+
+  free(me->nodes.fsms);
+  me->nodes.fsms = order;
+
+  /* The events are queued with the rank of their target */
+  for (size_t i = 0; i < len; i++) {
+    order[i]->bus_rank = i;
+  }
+
+  return FSM_ERR_OK;
+}
+
+static size_t deliver(fsm_bus_t *const me, size_t rank) {
+  fsm_bus_list_t *list = &me->nodes.pending[rank];
+  size_t count = 0;
+  size_t i = list->head;
+
+  while (i != NO_EVENT) {
+    fsm_bus_event_t *event = &me->queue.events[i];
+
+    /* A second value for the same input waits for the next pass, so the
+    instance sees both. The following events wait too to keep the order */
+    fsm_bus_mark_t *mark = find_mark(me, event->input);
+    if (mark->pass == me->delivered.pass) {
+      break;
+    }
+
+    mark->input = event->input;
+    mark->pass = me->delivered.pass;
+    fsm_input_set(event->input, event->val);
+    event->rank = RANK_DELIVERED;
+    count++;
+    i = event->next;
+  }
+
+  list->head = i;
+  if (i == NO_EVENT) {
+    list->tail = NO_EVENT;
+  }
+
+  return count;
+}
+
+static void enqueue(fsm_bus_t *const me, size_t index) {
+  fsm_bus_list_t *list = &me->nodes.pending[me->queue.events[index].rank];
+  me->queue.events[index].next = NO_EVENT;
+
+  if (list->tail == NO_EVENT) {
+    list->head = index;
+  } else {
+    me->queue.events[list->tail].next = index;
+  }
+
+  list->tail = index;
+}
+
+static fsm_bus_mark_t *find_mark(fsm_bus_t *const me, const fsm_input_t *input) {
+  /* At most one mark per event is taken in a pass, so there is always a free
+  one */
+  size_t mask = me->delivered.size - 1;
+  size_t i = (size_t)(((uintptr_t)input >> 2) * 2654435761u) & mask;
+  fsm_bus_mark_t *marks = me->delivered.marks;
+
+  while (marks[i].pass == me->delivered.pass && marks[i].input != input) {
+    i = (i + 1) & mask;
+  }
+
+  return &marks[i];
+}
+
+static void compact(fsm_bus_t *const me) {
+  size_t len = 0;
+
+  for (size_t i = 0; i < me->nodes.len; i++) {
+    me->nodes.pending[i].head = NO_EVENT;
+    me->nodes.pending[i].tail = NO_EVENT;
+  }
+
+  /* The events left keep their order and are linked again at their new
+  positions */
+  for (size_t i = 0; i < me->queue.len; i++) {
+    if (me->queue.events[i].rank != RANK_DELIVERED) {
+      me->queue.events[len] = me->queue.events[i];
+      enqueue(me, len++);
+    }
+  }
+
+  me->queue.len = len;
+}
+
+/***************************** END OF FILE ************************************/
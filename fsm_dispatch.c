@@ -0,0 +1,200 @@
+/**
+ ******************************************************************************
+ * @file           : fsm_dispatch.c
+ * @author         : Mauricio Barroso Benavides
+ * @date           : Oct 18, 2026
+ * @brief          : This file provides code for the configuration and control
+ *                   of the FSM actions dispatch queue
+ ******************************************************************************
+ * @attention
+ *
+ * MIT License
+ *
+ * Copyright (c) 2026 Mauricio Barroso Benavides
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm_dispatch.h"
+
+/* External variables --------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private function prototypes -----------------------------------------------*/
+static fsm_err_t push_record(fsm_dispatch_t *const me, fsm_action_t action,
+                             void *ctx);
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Exported functions --------------------------------------------------------*/
+/**
+ * @brief Function to initialize a dispatch queue.
+ */
+fsm_err_t fsm_dispatch_init(fsm_dispatch_t *const me, size_t len) {
+  /* Check if the queue instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the number of records is a power of 2 */
+  if (len == 0 || (len & (len - 1)) != 0) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Allocate memory for the records and check */
+  me->records = malloc(len * sizeof *me->records);
+
+  if (me->records == NULL) {
+    return FSM_ERR_NO_MEM;
+  }
+
+  /* Set default values */
+  me->len = len;
+  me->head = 0;
+  me->tail = 0;
+  me->dropped = 0;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to deinitialize a dispatch queue.
+ */
+fsm_err_t fsm_dispatch_deinit(fsm_dispatch_t *const me) {
+  /* Check if the queue instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  free(me->records);
+  me->records = NULL;
+  me->len = 0;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to add an action to a dispatch queue.
+ */
+fsm_err_t fsm_dispatch_push(fsm_dispatch_t *const me, fsm_fn_t fn, void *arg) {
+  /* Check if the queue instance and the action are valid */
+  if (me == NULL || fn == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  return push_record(me, (fsm_action_t){.fn = fn, .arg = arg, .ctx = false},
+                     NULL);
+}
+
+/**
+ * @brief Function to add an action that gets the context of a FSM instance to
+ *        a dispatch queue.
+ */
+fsm_err_t fsm_dispatch_push_ctx(fsm_dispatch_t *const me, fsm_fn_ctx_t fn,
+                                void *ctx, void *arg) {
+  /* Check if the queue instance and the action are valid */
+  if (me == NULL || fn == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  return push_record(
+      me, (fsm_action_t){.fn_ctx = fn, .arg = arg, .ctx = true}, ctx);
+}
+
+/**
+ * @brief Function to execute the pending actions of a dispatch queue.
+ */
+fsm_err_t fsm_dispatch_drain(fsm_dispatch_t *const me, size_t max,
+                             size_t *executed) {
+  /* Check if the queue instance is valid */
+  if (me == NULL || me->records == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  size_t count = 0;
+  size_t tail = __atomic_load_n(&me->tail, __ATOMIC_ACQUIRE);
+
+  while (max == 0 || count < max) {
+    size_t head = __atomic_load_n(&me->head, __ATOMIC_ACQUIRE);
+    if (tail == head) {
+      break;
+    }
+
+    /* Copy the record before claiming it, once claimed the producer can
+    overwrite it */
+    fsm_dispatch_record_t *record = &me->records[tail & (me->len - 1)];
+    fsm_action_t action;
+    action.fn = __atomic_load_n(&record->action.fn, __ATOMIC_RELAXED);
+    action.arg = __atomic_load_n(&record->action.arg, __ATOMIC_RELAXED);
+    action.ctx = __atomic_load_n(&record->action.ctx, __ATOMIC_RELAXED);
+    void *ctx = __atomic_load_n(&record->ctx, __ATOMIC_RELAXED);
+
+    if (__atomic_compare_exchange_n(&me->tail, &tail, tail + 1, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      if (action.ctx) {
+        action.fn_ctx(ctx, action.arg);
+      } else {
+        action.fn(action.arg);
+      }
+      count++;
+      tail++;
+    }
+  }
+
+  if (executed != NULL) {
+    *executed = count;
+  }
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/* Private functions ---------------------------------------------------------*/
+static fsm_err_t push_record(fsm_dispatch_t *const me, fsm_action_t action,
+                             void *ctx) {
+  size_t head = me->head;
+  size_t tail = __atomic_load_n(&me->tail, __ATOMIC_ACQUIRE);
+
+  /* Check if there is a free record */
+  if (head - tail >= me->len) {
+    __atomic_add_fetch(&me->dropped, 1, __ATOMIC_RELAXED);
+    return FSM_ERR_NO_MEM;
+  }
+
+  /* Write the record and publish it */
+  fsm_dispatch_record_t *record = &me->records[head & (me->len - 1)];
+  __atomic_store_n(&record->action.fn, action.fn, __ATOMIC_RELAXED);
+  __atomic_store_n(&record->action.arg, action.arg, __ATOMIC_RELAXED);
+  __atomic_store_n(&record->action.ctx, action.ctx, __ATOMIC_RELAXED);
+  __atomic_store_n(&record->ctx, ctx, __ATOMIC_RELAXED);
+  __atomic_store_n(&me->head, head + 1, __ATOMIC_RELEASE);
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/***************************** END OF FILE ************************************/
@@ -0,0 +1,268 @@
+/**
+ ******************************************************************************
+ * @file           : fsm_fleet.c
+ * @author         : Mauricio Barroso Benavides
+ * @date           : Oct 18, 2026
+ * @brief          : This file provides code for the configuration and control
+ *                   of the FSM fleet
+ ******************************************************************************
+ * @attention
+ *
+ * MIT License
+ *
+ * Copyright (c) 2026 Mauricio Barroso Benavides
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm_fleet.h"
+
+#include <stddef.h>
+
+/* External variables --------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private macro -------------------------------------------------------------*/
+#define LINK_TO_FSM(l) ((fsm_t *)((char *)(l) - offsetof(fsm_t, fleet_link)))
+
+/* Private function prototypes -----------------------------------------------*/
+static size_t list_index(fsm_fleet_t *const me, uint8_t state);
+static void list_init(fsm_fleet_link_t *head);
+static void list_insert(fsm_fleet_link_t *head, fsm_fleet_link_t *node);
+static void list_remove(fsm_fleet_link_t *node);
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Exported functions --------------------------------------------------------*/
+/**
+ * @brief Function to initialize a fleet.
+ */
+fsm_err_t fsm_fleet_init(fsm_fleet_t *const me, size_t len) {
+  /* Check if the fleet instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the number of states is valid */
+  if (len == 0 || len > UINT8_MAX + 1) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Allocate memory for the lists and their counters and check */
+  me->lists = malloc((len + 1) * sizeof *me->lists);
+  me->counts = malloc((len + 1) * sizeof *me->counts);
+
+  if (me->lists == NULL || me->counts == NULL) {
+    free(me->lists);
+    free(me->counts);
+    me->lists = NULL;
+    me->counts = NULL;
+    return FSM_ERR_NO_MEM;
+  }
+
+  /* Set default values */
+  for (size_t i = 0; i <= len; i++) {
+    list_init(&me->lists[i]);
+    me->counts[i] = 0;
+  }
+
+  me->len = len;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to deinitialize a fleet.
+ */
+fsm_err_t fsm_fleet_deinit(fsm_fleet_t *const me) {
+  /* Check if the fleet instance is valid */
+  if (me == NULL || me->lists == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Detach all the registered instances */
+  for (size_t i = 0; i <= me->len; i++) {
+    fsm_fleet_link_t *head = &me->lists[i];
+    while (head->next != head) {
+      fsm_fleet_link_t *node = head->next;
+      list_remove(node);
+      LINK_TO_FSM(node)->fleet = NULL;
+    }
+  }
+
+  free(me->lists);
+  free(me->counts);
+  me->lists = NULL;
+  me->counts = NULL;
+  me->len = 0;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to register a FSM instance in a fleet.
+ */
+fsm_err_t fsm_fleet_add(fsm_fleet_t *const me, fsm_t *fsm) {
+  /* Check if the fleet and FSM instances are valid */
+  if (me == NULL || me->lists == NULL || fsm == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the FSM instance is registered in other fleet */
+  if (fsm->fleet != NULL) {
+    return fsm->fleet == me ? FSM_ERR_OK : FSM_ERR_INVALID_PARAM;
+  }
+
+  fsm->fleet = me;
+  fsm->fleet_link.state = fsm->current_state;
+
+  size_t i = list_index(me, fsm->current_state);
+  list_insert(&me->lists[i], &fsm->fleet_link);
+  me->counts[i]++;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to remove a FSM instance from a fleet.
+ */
+fsm_err_t fsm_fleet_remove(fsm_fleet_t *const me, fsm_t *fsm) {
+  /* Check if the fleet and FSM instances are valid */
+  if (me == NULL || fsm == NULL || fsm->fleet != me) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  list_remove(&fsm->fleet_link);
+  me->counts[list_index(me, fsm->fleet_link.state)]--;
+  fsm->fleet = NULL;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to get the number of FSM instances of a fleet in a state.
+ */
+fsm_err_t fsm_fleet_count(fsm_fleet_t *const me, uint8_t state,
+                          size_t *count) {
+  /* Check if the fleet instance, the state and the count pointer are valid */
+  if (me == NULL || me->lists == NULL || state >= me->len || count == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  *count = me->counts[state];
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to call a function for each FSM instance of a fleet in a
+ *        state.
+ */
+fsm_err_t fsm_fleet_foreach(fsm_fleet_t *const me, uint8_t state,
+                            fsm_fleet_fn_t fn, void *arg) {
+  /* Check if the fleet instance, the state and the function are valid */
+  if (me == NULL || me->lists == NULL || state >= me->len || fn == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Take the instances of the state, so the ones that the function moves
+  don't break the walk */
+  fsm_fleet_link_t *head = &me->lists[state];
+  fsm_fleet_link_t visit;
+  list_init(&visit);
+  while (head->next != head) {
+    fsm_fleet_link_t *node = head->next;
+    list_remove(node);
+    list_insert(&visit, node);
+  }
+
+  /* Give back each instance before calling the function, the counters don't
+  change while they are in the visit list */
+  while (visit.next != &visit) {
+    fsm_fleet_link_t *node = visit.next;
+    list_remove(node);
+    list_insert(head, node);
+    fn(LINK_TO_FSM(node), arg);
+  }
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to move a FSM instance registered in a fleet to the list of
+ *        its current state.
+ */
+fsm_err_t fsm_fleet_update(fsm_fleet_t *const me, fsm_t *fsm) {
+  /* Check if the fleet and FSM instances are valid */
+  if (me == NULL || fsm == NULL || fsm->fleet != me) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  if (fsm->fleet_link.state == fsm->current_state) {
+    return FSM_ERR_OK;
+  }
+
+  list_remove(&fsm->fleet_link);
+  me->counts[list_index(me, fsm->fleet_link.state)]--;
+
+  fsm->fleet_link.state = fsm->current_state;
+
+  size_t i = list_index(me, fsm->current_state);
+  list_insert(&me->lists[i], &fsm->fleet_link);
+  me->counts[i]++;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/* Private functions ---------------------------------------------------------*/
+static size_t list_index(fsm_fleet_t *const me, uint8_t state) {
+  return state < me->len ? state : me->len;
+}
+
+static void list_init(fsm_fleet_link_t *head) {
+  head->next = head;
+  head->prev = head;
+}
+
+static void list_insert(fsm_fleet_link_t *head, fsm_fleet_link_t *node) {
+  node->next = head;
+  node->prev = head->prev;
+  head->prev->next = node;
+  head->prev = node;
+}
+
+static void list_remove(fsm_fleet_link_t *node) {
+  node->prev->next = node->next;
+  node->next->prev = node->prev;
+  node->next = NULL;
+  node->prev = NULL;
+}
+
+/***************************** END OF FILE ************************************/
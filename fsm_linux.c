@@ -0,0 +1,256 @@
+/**
+ ******************************************************************************
+ * @file           : fsm_linux.c
+ * @author         : Mauricio Barroso Benavides
+ * @date           : Oct 18, 2026
+ * @brief          : This file provides code for the configuration and control
+ *                   of the FSM Linux event loop
+ ******************************************************************************
+ * @attention
+ *
+ * MIT License
+ *
+ * Copyright (c) 2026 Mauricio Barroso Benavides
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#define _POSIX_C_SOURCE 200809L /* clock_gettime() with -std=c11 */
+
+#include "fsm_linux.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+/* External variables --------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private function prototypes -----------------------------------------------*/
+static int arm_timer(fsm_linux_loop_t *const me);
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Exported functions --------------------------------------------------------*/
+/**
+ * @brief Function to get the CLOCK_MONOTONIC time in ms.
+ */
+uint32_t fsm_linux_get_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+/**
+ * @brief Function to initialize an event loop.
+ */
+fsm_err_t fsm_linux_loop_init(fsm_linux_loop_t *const me, size_t len,
+                              uint32_t tick_ms) {
+  /* Check if the loop instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  fsm_err_t ret = fsm_wheel_init(&me->wheel, len, tick_ms, fsm_linux_get_ms());
+  if (ret != FSM_ERR_OK) {
+    return ret;
+  }
+
+  /* Create the epoll set and the timer to wake up on the next timeout */
+  me->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  me->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+  /* The timer is identified by a NULL source */
+  struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+  if (me->epoll_fd < 0 || me->timer_fd < 0 ||
+      epoll_ctl(me->epoll_fd, EPOLL_CTL_ADD, me->timer_fd, &ev) < 0) {
+    fsm_linux_loop_deinit(me);
+    return FSM_ERR_FAIL;
+  }
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to deinitialize an event loop.
+ */
+fsm_err_t fsm_linux_loop_deinit(fsm_linux_loop_t *const me) {
+  /* Check if the loop instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  if (me->timer_fd >= 0) {
+    close(me->timer_fd);
+    me->timer_fd = -1;
+  }
+
+  if (me->epoll_fd >= 0) {
+    close(me->epoll_fd);
+    me->epoll_fd = -1;
+  }
+
+  fsm_wheel_deinit(&me->wheel);
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to register a FSM instance in an event loop.
+ */
+fsm_err_t fsm_linux_loop_add(fsm_linux_loop_t *const me, fsm_t *fsm) {
+  /* Check if the loop instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  return fsm_wheel_add(&me->wheel, fsm);
+}
+
+/**
+ * @brief Function to register a file descriptor that feeds the events of a
+ *        FSM instance.
+ */
+fsm_err_t fsm_linux_loop_add_fd(fsm_linux_loop_t *const me,
+                                fsm_linux_source_t *src, int fd, fsm_t *fsm,
+                                fsm_linux_fd_fn_t fn, void *arg) {
+  /* Check if the loop instance and the source are valid */
+  if (me == NULL || src == NULL || fd < 0 || fsm == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  src->fd = fd;
+  src->fsm = fsm;
+  src->fn = fn;
+  src->arg = arg;
+
+  struct epoll_event ev = {.events = EPOLLIN, .data.ptr = src};
+  if (epoll_ctl(me->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    return FSM_ERR_FAIL;
+  }
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to remove a file descriptor from an event loop.
+ */
+fsm_err_t fsm_linux_loop_remove_fd(fsm_linux_loop_t *const me,
+                                   fsm_linux_source_t *src) {
+  /* Check if the loop instance and the source are valid */
+  if (me == NULL || src == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  if (epoll_ctl(me->epoll_fd, EPOLL_CTL_DEL, src->fd, NULL) < 0) {
+    return FSM_ERR_FAIL;
+  }
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to wait for work and run the FSM instances that have it.
+ */
+fsm_err_t fsm_linux_loop_run_once(fsm_linux_loop_t *const me, int timeout_ms) {
+  /* Check if the loop instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Run the instances already due and arm the timer to the next timeout */
+  fsm_wheel_advance(&me->wheel, fsm_linux_get_ms(), NULL);
+
+  if (arm_timer(me) < 0) {
+    return FSM_ERR_FAIL;
+  }
+
+  /* Sleep until there is work */
+  struct epoll_event events[FSM_LINUX_EVENTS_MAX];
+  int n = epoll_wait(me->epoll_fd, events, FSM_LINUX_EVENTS_MAX, timeout_ms);
+
+  if (n < 0) {
+    return errno == EINTR ? FSM_ERR_OK : FSM_ERR_FAIL;
+  }
+
+  for (int i = 0; i < n; i++) {
+    fsm_linux_source_t *src = events[i].data.ptr;
+
+    if (src == NULL) {
+      /* Clear the timer, the expired instances are run below */
+      uint64_t expirations;
+      ssize_t ret = read(me->timer_fd, &expirations, sizeof expirations);
+      (void)ret;
+    } else {
+      /* Read the input and run its instance with the clock of the wheel */
+      if (src->fn != NULL) {
+        src->fn(src->fd, src->arg);
+      }
+
+      if (src->fsm->time64.get_ticks != NULL) {
+        fsm_run_at_ticks(src->fsm, src->fsm->time64.get_ticks());
+      } else {
+        fsm_run_at(src->fsm, fsm_linux_get_ms());
+      }
+    }
+  }
+
+  fsm_wheel_advance(&me->wheel, fsm_linux_get_ms(), NULL);
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/* Private functions ---------------------------------------------------------*/
+static int arm_timer(fsm_linux_loop_t *const me) {
+  struct itimerspec spec = {0};
+  uint32_t expiry_ms;
+
+  /* A zero it_value disarms the timer */
+  if (fsm_wheel_next_expiry(&me->wheel, &expiry_ms) == FSM_ERR_OK) {
+    int32_t delay_ms = (int32_t)(expiry_ms - fsm_linux_get_ms());
+    if (delay_ms > 0) {
+      spec.it_value.tv_sec = delay_ms / 1000;
+      spec.it_value.tv_nsec = (long)(delay_ms % 1000) * 1000000;
+    } else {
+      spec.it_value.tv_nsec = 1;
+    }
+  }
+
+  return timerfd_settime(me->timer_fd, 0, &spec, NULL);
+}
+
+#endif /* __linux__ */
+
+/***************************** END OF FILE ************************************/
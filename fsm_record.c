@@ -0,0 +1,314 @@
+/**
+ ******************************************************************************
+ * @file           : fsm_record.c
+ * @author         : Mauricio Barroso Benavides
+ * @date           : Oct 18, 2026
+ * @brief          : This file provides code for the configuration and control
+ *                   of the FSM input recorder
+ ******************************************************************************
+ * @attention
+ *
+ * MIT License
+ *
+ * Copyright (c) 2026 Mauricio Barroso Benavides
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm_record.h"
+#include "fsm_array.h"
+
+#include <stddef.h>
+
+/* External variables --------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private macro -------------------------------------------------------------*/
+#define VARINT_MAX 10 /* Bytes of the longest varint */
+
+/* Private function prototypes -----------------------------------------------*/
+static bool reserve(fsm_recorder_t *const me, size_t bytes);
+static void put_varint(fsm_recorder_t *const me, uint64_t val);
+static bool get_varint(const uint8_t *buf, size_t len, size_t *pos,
+                       uint64_t *val);
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Exported functions --------------------------------------------------------*/
+/**
+ * @brief Function to initialize an input recorder.
+ */
+fsm_err_t fsm_recorder_init(fsm_recorder_t *const me, size_t max_size) {
+  /* Check if the recorder instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Set default values */
+  me->inputs_list.inputs = NULL;
+  me->inputs_list.len = 0;
+  me->buf = NULL;
+  me->len = 0;
+  me->size = 0;
+  me->max_size = max_size;
+  me->last_ms = 0;
+  me->runs = 0;
+  me->truncated = false;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to deinitialize an input recorder.
+ */
+fsm_err_t fsm_recorder_deinit(fsm_recorder_t *const me) {
+  /* Check if the recorder instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  free(me->inputs_list.inputs);
+  free(me->buf);
+
+  return fsm_recorder_init(me, me->max_size);
+}
+
+/**
+ * @brief Function to add an input to the inputs watched by a recorder.
+ */
+fsm_err_t fsm_recorder_watch(fsm_recorder_t *const me, int *val,
+                             fsm_input_t *input) {
+  /* Check if the recorder instance and the value pointer are valid */
+  if (me == NULL || val == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* The same input can be compared by several events */
+  for (size_t i = 0; i < me->inputs_list.len; i++) {
+    if (me->inputs_list.inputs[i].val == val) {
+      return FSM_ERR_OK;
+    }
+  }
+
+  fsm_recorder_input_t *ptr =
+      fsm_array_grow(me->inputs_list.inputs, me->inputs_list.len,
+                     me->inputs_list.len + 1, sizeof *ptr);
+
+  if (ptr == NULL) {
+    return FSM_ERR_NO_MEM;
+  }
+
+  ptr[me->inputs_list.len].val = val;
+  ptr[me->inputs_list.len].input = input;
+  ptr[me->inputs_list.len].last = 0;
+  me->inputs_list.inputs = ptr;
+  me->inputs_list.len++;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to record the inputs of a run.
+ */
+fsm_err_t fsm_recorder_sample(fsm_recorder_t *const me, uint32_t now_ms) {
+  /* Check if the recorder instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  if (me->truncated) {
+    return FSM_ERR_NO_MEM;
+  }
+
+  /* The first run records all the inputs relative to 0, so the replay doesn't
+  depend on their values before the recording */
+  size_t changes = 0;
+  for (size_t i = 0; i < me->inputs_list.len; i++) {
+    fsm_recorder_input_t *in = &me->inputs_list.inputs[i];
+    if (me->runs == 0 || *in->val != in->last) {
+      changes++;
+    }
+  }
+
+  if (!reserve(me, VARINT_MAX * (2 + 2 * changes))) {
+    me->truncated = true;
+    return FSM_ERR_NO_MEM;
+  }
+
+  /* Header: time delta and changes flag */
+  uint64_t delta_ms = (uint32_t)(now_ms - me->last_ms);
+  put_varint(me, delta_ms << 1 | (changes != 0));
+
+  if (changes) {
+    put_varint(me, changes);
+    for (size_t i = 0; i < me->inputs_list.len; i++) {
+      fsm_recorder_input_t *in = &me->inputs_list.inputs[i];
+      int val = *in->val;
+      if (me->runs != 0 && val == in->last) {
+        continue;
+      }
+
+      /* Zigzag encoding keeps small negative deltas short */
+      int32_t diff = (int32_t)((uint32_t)val - (uint32_t)in->last);
+      put_varint(me, i);
+      put_varint(me, (uint32_t)diff << 1 ^ -((uint32_t)diff >> 31));
+      in->last = val;
+    }
+  }
+
+  me->last_ms = now_ms;
+  me->runs++;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to replay a log into a FSM instance.
+ */
+fsm_err_t fsm_replay(fsm_t *fsm, const uint8_t *buf, size_t len,
+                     size_t *runs) {
+  /* Check if the FSM instance and the log are valid */
+  if (fsm == NULL || (buf == NULL && len)) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Get the inputs in the same order that they were recorded */
+  fsm_recorder_t map, *recorder = fsm->recorder;
+  fsm_recorder_init(&map, 0);
+  fsm_err_t ret = fsm_set_recorder(fsm, &map);
+  fsm->recorder = NULL;
+
+  size_t pos = 0, count = 0;
+  uint32_t now_ms = 0;
+  fsm_recorder_input_t *inputs = map.inputs_list.inputs;
+
+  while (ret == FSM_ERR_OK && pos < len) {
+    uint64_t header, changes = 0;
+    if (!get_varint(buf, len, &pos, &header)) {
+      ret = FSM_ERR_FAIL;
+      break;
+    }
+
+    if (header & 1 && !get_varint(buf, len, &pos, &changes)) {
+      ret = FSM_ERR_FAIL;
+      break;
+    }
+
+    /* Apply the recorded values */
+    for (uint64_t i = 0; i < changes && ret == FSM_ERR_OK; i++) {
+      uint64_t index, zigzag;
+      if (!get_varint(buf, len, &pos, &index) ||
+          !get_varint(buf, len, &pos, &zigzag) ||
+          index >= map.inputs_list.len) {
+        ret = FSM_ERR_FAIL;
+        break;
+      }
+
+      fsm_recorder_input_t *in = &inputs[index];
+      uint32_t mag = (uint32_t)(zigzag >> 1);
+      int32_t diff = (int32_t)(mag ^ -(uint32_t)(zigzag & 1));
+      in->last = (int)((uint32_t)in->last + (uint32_t)diff);
+
+      if (in->input != NULL) {
+        fsm_input_set(in->input, in->last);
+      } else {
+        *in->val = in->last;
+      }
+    }
+
+    if (ret != FSM_ERR_OK) {
+      break;
+    }
+
+    now_ms += (uint32_t)(header >> 1);
+    fsm_run_at(fsm, now_ms);
+    count++;
+  }
+
+  fsm_recorder_deinit(&map);
+  fsm->recorder = recorder;
+
+  if (runs != NULL) {
+    *runs = count;
+  }
+
+  return ret;
+}
+
+/* Private functions ---------------------------------------------------------*/
+static bool reserve(fsm_recorder_t *const me, size_t bytes) {
+  if (me->len + bytes <= me->size) {
+    return true;
+  }
+
+  /* Grow geometrically up to the maximum size */
+  size_t size = me->size ? me->size : 64;
+  while (size < me->len + bytes) {
+    size *= 2;
+  }
+
+  if (me->max_size && size > me->max_size) {
+    size = me->max_size;
+    if (size < me->len + bytes) {
+      return false;
+    }
+  }
+
+  uint8_t *ptr = realloc(me->buf, size);
+  if (ptr == NULL) {
+    return false;
+  }
+
+  me->buf = ptr;
+  me->size = size;
+
+  return true;
+}
+
+static void put_varint(fsm_recorder_t *const me, uint64_t val) {
+  while (val >= 0x80) {
+    me->buf[me->len++] = (uint8_t)(val | 0x80);
+    val >>= 7;
+  }
+  me->buf[me->len++] = (uint8_t)val;
+}
+
+static bool get_varint(const uint8_t *buf, size_t len, size_t *pos,
+                       uint64_t *val) {
+  *val = 0;
+  for (unsigned int shift = 0; *pos < len && shift < 7 * VARINT_MAX;
+       shift += 7) {
+    uint8_t byte = buf[(*pos)++];
+    *val |= (uint64_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/***************************** END OF FILE ************************************/
@@ -0,0 +1,278 @@
+/**
+ ******************************************************************************
+ * @file           : fsm_sim.c
+ * @author         : Mauricio Barroso Benavides
+ * @date           : Oct 18, 2026
+ * @brief          : This file provides code for the configuration and control
+ *                   of the FSM virtual time simulator
+ ******************************************************************************
+ * @attention
+ *
+ * MIT License
+ *
+ * Copyright (c) 2026 Mauricio Barroso Benavides
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm_sim.h"
+
+#include <stddef.h>
+
+/* External variables --------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private function prototypes -----------------------------------------------*/
+static bool is_before(uint32_t a_ms, uint32_t b_ms);
+static bool event_less(const fsm_sim_event_t *a, const fsm_sim_event_t *b);
+static void queue_push(fsm_sim_t *const me, const fsm_sim_event_t *event);
+static void queue_pop(fsm_sim_t *const me, fsm_sim_event_t *event);
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Exported functions --------------------------------------------------------*/
+/**
+ * @brief Function to initialize a simulator.
+ */
+fsm_err_t fsm_sim_init(fsm_sim_t *const me, size_t len, uint32_t tick_ms) {
+  /* Check if the simulator instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Set default values */
+  me->queue.events = NULL;
+  me->queue.len = 0;
+  me->queue.size = 0;
+  me->seq = 0;
+  me->now_ms = 0;
+
+  return fsm_wheel_init(&me->wheel, len, tick_ms, me->now_ms);
+}
+
+/**
+ * @brief Function to deinitialize a simulator.
+ */
+fsm_err_t fsm_sim_deinit(fsm_sim_t *const me) {
+  /* Check if the simulator instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  free(me->queue.events);
+  me->queue.events = NULL;
+  me->queue.len = 0;
+  me->queue.size = 0;
+
+  return fsm_wheel_deinit(&me->wheel);
+}
+
+/**
+ * @brief Function to add a FSM instance to a simulator.
+ */
+fsm_err_t fsm_sim_add(fsm_sim_t *const me, fsm_t *fsm) {
+  /* Check if the simulator instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the FSM instance runs in ms, the virtual time can't drive a 64-bit
+  time source */
+  if (fsm == NULL || fsm->time64.get_ticks != NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  return fsm_wheel_add(&me->wheel, fsm);
+}
+
+/**
+ * @brief Function to inject an input event in a simulator.
+ */
+fsm_err_t fsm_sim_inject(fsm_sim_t *const me, uint32_t time_ms, fsm_t *fsm,
+                         fsm_fn_t fn, void *arg) {
+  /* Check if the simulator instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the event time is not in the past */
+  if (is_before(time_ms, me->now_ms)) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Grow the queue geometrically */
+  if (me->queue.len == me->queue.size) {
+    size_t size = me->queue.size ? me->queue.size * 2 : 16;
+    fsm_sim_event_t *ptr = realloc(me->queue.events, size * sizeof *ptr);
+
+    if (ptr == NULL) {
+      return FSM_ERR_NO_MEM;
+    }
+
+    me->queue.events = ptr;
+    me->queue.size = size;
+  }
+
+  fsm_sim_event_t event = {
+      .time_ms = time_ms, .seq = me->seq++, .fsm = fsm, .fn = fn, .arg = arg};
+  queue_push(me, &event);
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to run a simulator until a virtual time.
+ */
+fsm_err_t fsm_sim_run_until(fsm_sim_t *const me, uint32_t end_ms,
+                            size_t *runs) {
+  /* Check if the simulator instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  size_t count = 0;
+
+  for (;;) {
+    /* Jump to the earliest input event or timeout */
+    uint32_t next_ms = 0, expiry_ms;
+    bool found = false;
+
+    if (me->queue.len) {
+      next_ms = me->queue.events[0].time_ms;
+      found = true;
+    }
+
+    if (fsm_wheel_next_expiry(&me->wheel, &expiry_ms) == FSM_ERR_OK &&
+        (!found || is_before(expiry_ms, next_ms))) {
+      next_ms = expiry_ms;
+      found = true;
+    }
+
+    if (!found || is_before(end_ms, next_ms)) {
+      break;
+    }
+
+    /* Timeouts armed in the past, e.g. before the instance was added, are
+    handled now */
+    if (is_before(me->now_ms, next_ms)) {
+      me->now_ms = next_ms;
+    }
+
+    /* Apply the inputs of this time and run their instances */
+    while (me->queue.len && me->queue.events[0].time_ms == me->now_ms) {
+      fsm_sim_event_t event;
+      queue_pop(me, &event);
+
+      if (event.fn != NULL) {
+        event.fn(event.arg);
+      }
+
+      if (event.fsm != NULL) {
+        fsm_run_at(event.fsm, me->now_ms);
+        count++;
+      }
+    }
+
+    /* Run the instances whose timeouts expired */
+    size_t expired = 0;
+    fsm_wheel_advance(&me->wheel, me->now_ms, &expired);
+    count += expired;
+  }
+
+  /* Nothing else happens until the end time */
+  if (is_before(me->now_ms, end_ms)) {
+    me->now_ms = end_ms;
+    fsm_wheel_advance(&me->wheel, me->now_ms, NULL);
+  }
+
+  if (runs != NULL) {
+    *runs = count;
+  }
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/* Private functions ---------------------------------------------------------*/
+static bool is_before(uint32_t a_ms, uint32_t b_ms) {
+  return (int32_t)(a_ms - b_ms) < 0;
+}
+
+static bool event_less(const fsm_sim_event_t *a, const fsm_sim_event_t *b) {
+  if (a->time_ms != b->time_ms) {
+    return is_before(a->time_ms, b->time_ms);
+  }
+
+  return (int32_t)(a->seq - b->seq) < 0;
+}
+
+static void queue_push(fsm_sim_t *const me, const fsm_sim_event_t *event) {
+  fsm_sim_event_t *events = me->queue.events;
+  size_t i = me->queue.len++;
+
+  /* Move the parents down until the place of the event is found */
+  while (i > 0) {
+    size_t parent = (i - 1) / 2;
+    if (!event_less(event, &events[parent])) {
+      break;
+    }
+    events[i] = events[parent];
+    i = parent;
+  }
+
+  events[i] = *event;
+}
+
+static void queue_pop(fsm_sim_t *const me, fsm_sim_event_t *event) {
+  fsm_sim_event_t *events = me->queue.events;
+  *event = events[0];
+
+  /* Move the last event from the root down to its place */
+  fsm_sim_event_t last = events[--me->queue.len];
+  size_t len = me->queue.len;
+  size_t i = 0;
+
+  for (;;) {
+    size_t child = 2 * i + 1;
+    if (child >= len) {
+      break;
+    }
+    if (child + 1 < len && event_less(&events[child + 1], &events[child])) {
+      child++;
+    }
+    if (!event_less(&events[child], &last)) {
+      break;
+    }
+    events[i] = events[child];
+    i = child;
+  }
+
+  if (len) {
+    events[i] = last;
+  }
+}
+
+/***************************** END OF FILE ************************************/
@@ -0,0 +1,352 @@
+/**
+ ******************************************************************************
+ * @file           : fsm_wheel.c
+ * @author         : Mauricio Barroso Benavides
+ * @date           : Oct 18, 2026
+ * @brief          : This file provides code for the configuration and control
+ *                   of the FSM timer wheel
+ ******************************************************************************
+ * @attention
+ *
+ * MIT License
+ *
+ * Copyright (c) 2026 Mauricio Barroso Benavides
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm_wheel.h"
+
+#include <stddef.h>
+
+/* External variables --------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private macro -------------------------------------------------------------*/
+#define TIMER_TO_FSM(t) ((fsm_t *)((char *)(t) - offsetof(fsm_t, timer)))
+
+/* Private function prototypes -----------------------------------------------*/
+static void list_init(fsm_timer_t *head);
+static void list_insert(fsm_timer_t *head, fsm_timer_t *node);
+static void list_remove(fsm_timer_t *node);
+static bool is_expired(uint32_t expiry_ms, uint32_t now_ms);
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Exported functions --------------------------------------------------------*/
+/**
+ * @brief Function to initialize a timer wheel.
+ */
+fsm_err_t fsm_wheel_init(fsm_wheel_t *const me, size_t len, uint32_t tick_ms,
+                         uint32_t now_ms) {
+  /* Check if the wheel instance is valid */
+  if (me == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the number of slots is a power of 2 */
+  if (len == 0 || (len & (len - 1)) != 0) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the tick is valid */
+  if (tick_ms == 0) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Allocate memory for the slots and check */
+  me->slots = malloc(len * sizeof *me->slots);
+
+  if (me->slots == NULL) {
+    return FSM_ERR_NO_MEM;
+  }
+
+  /* Set default values */
+  for (size_t i = 0; i < len; i++) {
+    list_init(&me->slots[i]);
+  }
+
+  list_init(&me->due);
+  me->len = len;
+  me->tick_ms = tick_ms;
+  me->now_ms = now_ms;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to deinitialize a timer wheel.
+ */
+fsm_err_t fsm_wheel_deinit(fsm_wheel_t *const me) {
+  /* Check if the wheel instance is valid */
+  if (me == NULL || me->slots == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Detach all the armed instances */
+  for (size_t i = 0; i <= me->len; i++) {
+    fsm_timer_t *head = i < me->len ? &me->slots[i] : &me->due;
+    while (head->next != head) {
+      fsm_timer_t *node = head->next;
+      list_remove(node);
+      TIMER_TO_FSM(node)->wheel = NULL;
+    }
+  }
+
+  free(me->slots);
+  me->slots = NULL;
+  me->len = 0;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to register a FSM instance in a timer wheel.
+ */
+fsm_err_t fsm_wheel_add(fsm_wheel_t *const me, fsm_t *fsm) {
+  /* Check if the wheel and FSM instances are valid */
+  if (me == NULL || fsm == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Check if the FSM instance is registered in other wheel */
+  if (fsm->wheel != NULL && fsm->wheel != me) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  fsm->wheel = me;
+
+  /* Run the instance in the next advance */
+  return fsm_wheel_schedule(me, fsm, me->now_ms);
+}
+
+/**
+ * @brief Function to remove a FSM instance from a timer wheel.
+ */
+fsm_err_t fsm_wheel_remove(fsm_wheel_t *const me, fsm_t *fsm) {
+  /* Check if the wheel and FSM instances are valid */
+  if (me == NULL || fsm == NULL || fsm->wheel != me) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  fsm_wheel_cancel(me, fsm);
+  fsm->wheel = NULL;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to advance a timer wheel and run the FSM instances whose
+ *        timers expired.
+ */
+fsm_err_t fsm_wheel_advance(fsm_wheel_t *const me, uint32_t now_ms,
+                            size_t *expired) {
+  /* Check if the wheel instance is valid */
+  if (me == NULL || me->slots == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Take the timers that were due before this advance */
+  fsm_timer_t fired;
+  list_init(&fired);
+  while (me->due.next != &me->due) {
+    fsm_timer_t *node = me->due.next;
+    list_remove(node);
+    list_insert(&fired, node);
+  }
+
+  /* Visit only the slots of the elapsed ticks, including the last visited
+  one, which can have timers scheduled after the previous advance */
+  uint32_t from_tick = me->now_ms / me->tick_ms;
+  uint32_t to_tick = now_ms / me->tick_ms;
+  size_t ticks = to_tick >= from_tick ? (size_t)(to_tick - from_tick) + 1
+                                      : me->len;
+  if (ticks > me->len) {
+    ticks = me->len;
+  }
+
+  for (size_t i = 0; i < ticks; i++) {
+    fsm_timer_t *head = &me->slots[(from_tick + i) & (me->len - 1)];
+    fsm_timer_t *node = head->next;
+    while (node != head) {
+      fsm_timer_t *next = node->next;
+
+      /* Timers of further rounds stay in the slot */
+      if (is_expired(node->expiry_ms, now_ms)) {
+        list_remove(node);
+        list_insert(&fired, node);
+      }
+      node = next;
+    }
+  }
+
+  me->now_ms = now_ms;
+
+  /* Run the expired instances. Timers armed by them that are already expired
+  go to the due list and are handled in the next advance */
+  size_t count = 0;
+  while (fired.next != &fired) {
+    fsm_timer_t *node = fired.next;
+    fsm_t *fsm = TIMER_TO_FSM(node);
+    list_remove(node);
+
+    /* The instances with a 64-bit time source read it, now_ms wraps around */
+    if (fsm->time64.get_ticks != NULL) {
+      fsm_run_at_ticks(fsm, fsm->time64.get_ticks());
+    } else {
+      fsm_run_at(fsm, now_ms);
+    }
+    count++;
+  }
+
+  if (expired != NULL) {
+    *expired = count;
+  }
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to get the earliest expiration time of the timers armed in
+ *        a timer wheel.
+ */
+fsm_err_t fsm_wheel_next_expiry(fsm_wheel_t *const me, uint32_t *expiry_ms) {
+  /* Check if the wheel instance and the expiry pointer are valid */
+  if (me == NULL || me->slots == NULL || expiry_ms == NULL) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Timers already due */
+  if (me->due.next != &me->due) {
+    *expiry_ms = me->now_ms;
+    return FSM_ERR_OK;
+  }
+
+  /* Visit the slots in time order until a slot starts after the earliest
+  timer found, timers of later rounds can be in any slot */
+  uint32_t tick = me->now_ms / me->tick_ms;
+  uint32_t best = 0;
+  bool found = false;
+
+  for (size_t i = 0; i < me->len; i++) {
+    uint32_t slot_ms = (tick + i) * me->tick_ms;
+    if (found && !is_expired(slot_ms, best)) {
+      break;
+    }
+
+    fsm_timer_t *head = &me->slots[(tick + i) & (me->len - 1)];
+    for (fsm_timer_t *node = head->next; node != head; node = node->next) {
+      if (!found || is_expired(node->expiry_ms, best)) {
+        best = node->expiry_ms;
+        found = true;
+      }
+    }
+  }
+
+  if (!found) {
+    return FSM_ERR_FAIL;
+  }
+
+  *expiry_ms = best;
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to arm the timer of a FSM instance registered in a timer
+ *        wheel.
+ */
+fsm_err_t fsm_wheel_schedule(fsm_wheel_t *const me, fsm_t *fsm,
+                             uint32_t expiry_ms) {
+  /* Check if the wheel and FSM instances are valid */
+  if (me == NULL || fsm == NULL || fsm->wheel != me) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  /* Disarm the previous timer */
+  if (fsm->timer.next != NULL) {
+    list_remove(&fsm->timer);
+  }
+
+  fsm->timer.expiry_ms = expiry_ms;
+
+  /* Insert the timer in the due list or in the slot of its tick */
+  if (is_expired(expiry_ms, me->now_ms)) {
+    list_insert(&me->due, &fsm->timer);
+  } else {
+    list_insert(&me->slots[(expiry_ms / me->tick_ms) & (me->len - 1)],
+                &fsm->timer);
+  }
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/**
+ * @brief Function to disarm the timer of a FSM instance registered in a timer
+ *        wheel.
+ */
+fsm_err_t fsm_wheel_cancel(fsm_wheel_t *const me, fsm_t *fsm) {
+  /* Check if the wheel and FSM instances are valid */
+  if (me == NULL || fsm == NULL || fsm->wheel != me) {
+    return FSM_ERR_INVALID_PARAM;
+  }
+
+  if (fsm->timer.next != NULL) {
+    list_remove(&fsm->timer);
+  }
+
+  /* Return success */
+  return FSM_ERR_OK;
+}
+
+/* Private functions ---------------------------------------------------------*/
+static void list_init(fsm_timer_t *head) {
+  head->next = head;
+  head->prev = head;
+}
+
+static void list_insert(fsm_timer_t *head, fsm_timer_t *node) {
+  node->next = head;
+  node->prev = head->prev;
+  head->prev->next = node;
+  head->prev = node;
+}
+
+static void list_remove(fsm_timer_t *node) {
+  node->prev->next = node->next;
+  node->next->prev = node->prev;
+  node->next = NULL;
+  node->prev = NULL;
+}
+
+static bool is_expired(uint32_t expiry_ms, uint32_t now_ms) {
+  return (int32_t)(expiry_ms - now_ms) <= 0;
+}
+
+/***************************** END OF FILE ************************************/
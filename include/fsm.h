@@ -46,10 +46,42 @@ extern "C" {
 #include <stdint.h>
 #include <stdlib.h>
 
+#if defined(ESP_PLATFORM)
+#include "sdkconfig.h"
+#endif
+
 /* Exported macro ------------------------------------------------------------*/
+#if defined(CONFIG_FSM_PACKED_LAYOUT) && CONFIG_FSM_PACKED_LAYOUT
+#define FSM_PACKED_LAYOUT 1 /* Small indices instead of pointers and size_t */
+#else
+#define FSM_PACKED_LAYOUT 0
+#endif
+
+#define FSM_SLOT_NONE 0xFF /* Empty slot index in FSM_PACKED_LAYOUT */
+#define FSM_PREDS_MAX 32 /* Max unique predicates in FSM_EVAL_MODE_BITSET */
+#define FSM_GUARD_MAX 255 /* Max instructions and operands of a guard */
+#define FSM_STATE_ANY (-1) /* Observer state filter that matches any state */
+
+/* Guard expression constructors */
+#define FSM_EXPR_CMP(v, c, e)                                                  \
+  (&(const fsm_expr_t){.type = FSM_EXPR_TYPE_CMP,                              \
+                       .event = {.val = (v), .cmp = (c), .eval = (e)}})
+#define FSM_EXPR_CMP_CTX(v, c, e)                                              \
+  (&(const fsm_expr_t){                                                        \
+      .type = FSM_EXPR_TYPE_CMP,                                               \
+      .event = {.val = (v), .cmp = (c), .eval_ctx = (e), .ctx = true}})
+#define FSM_EXPR_TIMEOUT(ms)                                                   \
+  (&(const fsm_expr_t){.type = FSM_EXPR_TYPE_TIMEOUT, .timeout = (ms)})
+#define FSM_EXPR_AND(l, r)                                                     \
+  (&(const fsm_expr_t){.type = FSM_EXPR_TYPE_AND, .args = {(l), (r)}})
+#define FSM_EXPR_OR(l, r)                                                      \
+  (&(const fsm_expr_t){.type = FSM_EXPR_TYPE_OR, .args = {(l), (r)}})
+#define FSM_EXPR_NOT(x)                                                        \
+  (&(const fsm_expr_t){.type = FSM_EXPR_TYPE_NOT, .args = {(x), NULL}})
 
 /* Exported types ------------------------------------------------------------*/
 typedef enum {
+  FSM_ERR_BUSY = -4,
   FSM_ERR_INVALID_PARAM = -3,
   FSM_ERR_NO_MEM = -2,
   FSM_ERR_FAIL = -1,
@@ -66,19 +98,96 @@ typedef enum {
 
 typedef enum { FSM_OP_OR = 0, FSM_OP_AND, FSM_OP_MAX } fsm_op_t;
 
+typedef enum {
+  FSM_EVAL_MODE_DEFAULT = 0,
+  FSM_EVAL_MODE_BITSET,
+  FSM_EVAL_MODE_MAX,
+} fsm_eval_mode_t;
+
 typedef bool (*fsm_eval_t)(int a, int b);
 
+/* Evaluation function that also gets the context of the FSM instance */
+typedef bool (*fsm_eval_ctx_t)(void *ctx, int a, int b);
+
+typedef union {
+  fsm_eval_t eval;
+  fsm_eval_ctx_t eval_ctx;
+} fsm_eval_fn_t;
+
+typedef struct {
+  int val;
+  uint32_t version; /* Incremented each time val changes */
+} fsm_input_t;
+
+#if FSM_PACKED_LAYOUT
 typedef struct {
   int *val;
   int cmp;
-  fsm_eval_t eval;
+  uint16_t seen;     /* Low bits of the input version used by the cached
+                        result, dropped when the state is entered */
+  uint8_t eval;      /* Slot in the evaluation functions pool */
+  uint8_t input : 1; /* val belongs to a fsm_input_t */
+  uint8_t ctx : 1;   /* The evaluation function is a fsm_eval_ctx_t */
+} fsm_event_t;
+#else
+typedef struct {
+  int *val;
+  int cmp;
+  union {
+    fsm_eval_t eval;
+    fsm_eval_ctx_t eval_ctx; /* If ctx */
+  };
+  fsm_input_t *input; /* NULL for plain int events */
+  uint32_t seen;      /* Input version used by the cached result */
+  bool ctx;
 } fsm_event_t;
+#endif
+
+typedef enum {
+  FSM_EXPR_TYPE_CMP = 0,
+  FSM_EXPR_TYPE_TIMEOUT,
+  FSM_EXPR_TYPE_AND,
+  FSM_EXPR_TYPE_OR,
+  FSM_EXPR_TYPE_NOT,
+  FSM_EXPR_TYPE_MAX,
+} fsm_expr_type_t;
+
+typedef struct fsm_expr fsm_expr_t;
+
+struct fsm_expr {
+  fsm_expr_type_t type;
+  union {
+    struct {
+      int *val;
+      int cmp;
+      union {
+        fsm_eval_t eval;
+        fsm_eval_ctx_t eval_ctx; /* If ctx */
+      };
+      bool ctx;
+    } event;          /* FSM_EXPR_TYPE_CMP */
+    uint32_t timeout; /* FSM_EXPR_TYPE_TIMEOUT */
+    struct {
+      const fsm_expr_t *lhs;
+      const fsm_expr_t *rhs;
+    } args; /* FSM_EXPR_TYPE_AND, FSM_EXPR_TYPE_OR and FSM_EXPR_TYPE_NOT */
+  };
+};
+
+typedef struct fsm_guard fsm_guard_t; /* Compiled guard expression */
 
 typedef void (*fsm_fn_t)(void *arg);
 
+/* Action function that also gets the context of the FSM instance */
+typedef void (*fsm_fn_ctx_t)(void *ctx, void *arg);
+
 typedef struct {
-  fsm_fn_t fn;
+  union {
+    fsm_fn_t fn;
+    fsm_fn_ctx_t fn_ctx; /* If ctx */
+  };
   void *arg;
+  bool ctx;
 } fsm_action_t;
 
 typedef struct {
@@ -86,6 +195,24 @@ typedef struct {
   size_t len;
 } fsm_actions_list_t;
 
+#if FSM_PACKED_LAYOUT
+typedef struct {
+  uint32_t timeout;
+  uint16_t events; /* First event in the events pool */
+  uint8_t events_len;
+  uint8_t present_state;
+  uint8_t next_state;
+  uint8_t op;
+  uint8_t action; /* Slot in the transition actions pool */
+  uint8_t guard;  /* Slot in the guards pool */
+
+  struct {
+    uint8_t enabled : 1; /* All the events are versioned inputs */
+    uint8_t valid : 1;
+    uint8_t res : 1;
+  } memo;
+} fsm_trans_t;
+#else
 typedef struct {
   uint8_t present_state;
   uint8_t next_state;
@@ -98,22 +225,258 @@ typedef struct {
   uint32_t timeout;
   fsm_op_t op;
   fsm_action_t action;
+  fsm_guard_t *guard; /* Replaces the events and timeout if not NULL */
+
+  struct {
+    bool enabled; /* All the events are versioned inputs */
+    bool valid;
+    bool res;
+  } memo;
 } fsm_trans_t;
+#endif
 
 typedef struct {
   fsm_trans_t *trans;
   size_t len;
 } fsm_trans_list_t;
 
+/* Declarative definition loaded with fsm_load(), it can be const */
+typedef struct {
+  int *val;
+  int cmp;
+  fsm_eval_t eval;
+} fsm_table_event_t;
+
+typedef struct {
+  uint8_t from_state;
+  uint8_t next_state;
+  fsm_op_t op;         /* Operator of the events and timeout */
+  uint32_t timeout;    /* Timeout in ms, 0 for none */
+  uint16_t events;     /* First event of the row in the events of the table */
+  uint8_t events_len;
+  fsm_fn_t fn;         /* Transition action, NULL for none */
+  void *arg;
+} fsm_table_row_t;
+
+typedef struct {
+  const fsm_table_row_t *rows; /* Transitions in priority order */
+  size_t rows_len;
+  const fsm_table_event_t *events; /* Events of all the rows */
+  size_t events_len;
+  const fsm_action_t (*states)[3]; /* Entry, update and exit actions of each
+                                      state, can be NULL */
+  size_t states_len;
+} fsm_table_t;
+
+typedef enum {
+  FSM_LOAD_COPY = 0, /* Build the definition of the instance from the table */
+  FSM_LOAD_REF,      /* Run from the table in place, read only */
+  FSM_LOAD_MAX,
+} fsm_load_mode_t;
+
+typedef uint32_t fsm_preds_t;
+
+typedef struct {
+  fsm_event_t *preds; /* Unique (val, cmp, eval) predicates */
+  fsm_preds_t *masks; /* Predicates needed by each transition */
+  size_t len;
+} fsm_preds_list_t;
+
+typedef struct {
+  uint32_t hits;
+  uint32_t misses;
+} fsm_memo_stats_t;
+
 typedef uint32_t (*fsm_time_t)(void);
 
+typedef uint64_t (*fsm_time64_t)(void);
+
+typedef struct fsm_timer {
+  struct fsm_timer *next;
+  struct fsm_timer *prev;
+  uint32_t expiry_ms;
+} fsm_timer_t;
+
+typedef struct fsm_fleet_link {
+  struct fsm_fleet_link *next;
+  struct fsm_fleet_link *prev;
+  uint8_t state; /* State of the list where the instance is linked */
+} fsm_fleet_link_t;
+
 typedef struct {
+  uint8_t state;
+  uint8_t prev_state; /* State before the last transition */
+  uint16_t seq;       /* Number of transitions, wraps around */
+} fsm_snapshot_t;
+
+struct fsm_wheel;
+struct fsm_fleet;
+struct fsm_dispatch;
+struct fsm_recorder;
+struct fsm_machine;
+
+/* Completion handle of an asynchronous action */
+typedef struct {
+  struct fsm_machine *fsm;
+  uint32_t id; /* Operation started by the action */
+} fsm_async_t;
+
+/* Asynchronous action, returns true if the operation completes later */
+typedef bool (*fsm_async_fn_t)(fsm_async_t op, void *arg);
+
+typedef void (*fsm_async_notify_t)(struct fsm_machine *fsm, void *arg);
+
+typedef struct {
+  fsm_async_fn_t fn;
+  void *arg;
+} fsm_async_action_t;
+
+typedef void (*fsm_observer_fn_t)(struct fsm_machine *fsm,
+                                  uint8_t from_state, uint8_t to_state,
+                                  void *arg);
+
+typedef enum {
+  FSM_VIOLATION_DWELL = 0, /* A state was active longer than its budget */
+  FSM_VIOLATION_ACTION,    /* An action took longer than its budget */
+  FSM_VIOLATION_MAX,
+} fsm_violation_type_t;
+
+typedef struct {
+  fsm_violation_type_t type;
+  uint8_t state;
+  fsm_action_type_t action; /* Action that overran, FSM_VIOLATION_ACTION only */
+  uint32_t budget;          /* Dwell in ms or action time in ticks */
+  uint32_t measured;        /* Time measured in the same unit as budget */
+  uint32_t start;           /* Time the state was entered or the action
+                               started */
+} fsm_violation_t;
+
+typedef void (*fsm_violation_fn_t)(struct fsm_machine *fsm,
+                                   const fsm_violation_t *violation,
+                                   void *arg);
+
+typedef struct {
+  uint32_t dwell_ms;     /* Max time in the state, 0 for no budget */
+  uint32_t action_ticks; /* Max time of each action of the state, 0 for no
+                            budget */
+} fsm_budget_t;
+
+typedef struct {
+  uint32_t dwell;
+  uint32_t action;
+} fsm_budget_stats_t;
+
+typedef struct {
+  size_t trans;   /* Transitions table */
+  size_t events;  /* Events of the transitions */
+  size_t actions; /* State and transition actions */
+  size_t guards;  /* Compiled guard expressions */
+  size_t other;   /* Predicates, budgets, observers groups and pools */
+  size_t total;
+} fsm_memory_usage_t;
+
+typedef struct fsm_observer {
+  struct fsm_observer *next; /* Link in the list of observers of the FSM */
+  fsm_observer_fn_t fn;
+  void *arg;
+  int16_t from_state; /* State filter, FSM_STATE_ANY for any state */
+  int16_t to_state;
+} fsm_observer_t;
+
+typedef struct fsm_machine {
   uint8_t current_state;
   uint8_t prev_state;
   fsm_trans_list_t trans_list;
   fsm_actions_list_t actions_list;
+  const fsm_table_t *table; /* Definition loaded with FSM_LOAD_REF */
   fsm_time_t get_ms;
   uint32_t entry_ms;
+
+  /* High resolution time base */
+  struct {
+    fsm_time64_t get_ticks; /* Free running clock, NULL to use get_ms */
+    uint32_t ticks_per_ms;  /* Resolution of the timeouts, 1 with get_ms */
+    uint64_t entry;         /* Time the current state was entered in ticks */
+    bool anchored;          /* entry set to the instant of the transition */
+  } time64;
+
+  fsm_eval_mode_t eval_mode;
+  fsm_preds_list_t preds_list;
+  fsm_memo_stats_t memo_stats;
+  struct fsm_wheel *wheel; /* Timer wheel where the instance is registered */
+  fsm_timer_t timer;
+  struct fsm_fleet *fleet; /* Fleet where the instance is registered */
+  fsm_fleet_link_t fleet_link;
+  struct fsm_bus *bus; /* Event bus where the instance is added */
+  size_t bus_rank;     /* Position of the instance in the order of the bus */
+  struct fsm_dispatch *dispatch; /* Queue for deferred actions */
+  uint32_t state_word; /* Published snapshot: state, prev_state and seq */
+  bool running;        /* fsm_run() in progress */
+  struct fsm_recorder *recorder; /* Log of the inputs of each run */
+  void *ctx; /* Passed to the fsm_eval_ctx_t and fsm_fn_ctx_t callbacks */
+
+  /* Latency budgets */
+  struct {
+    fsm_budget_t *budgets; /* Budgets of each state */
+    size_t len;
+    fsm_time_t get_ticks; /* Time source of the action budgets */
+    fsm_violation_fn_t fn;
+    void *arg;
+    fsm_budget_stats_t stats;
+    bool dwell_reported; /* Dwell violation of the current visit reported */
+  } budgets;
+
+  /* Asynchronous entry actions */
+  struct {
+    fsm_async_action_t *actions; /* Action of each state */
+    size_t len;
+    uint32_t pending;          /* Operation in progress, 0 for none */
+    uint32_t seq;              /* Last operation started */
+    fsm_input_t result;        /* Result of the last completed operation */
+    fsm_async_notify_t notify; /* Called when an operation completes */
+    void *arg;
+  } async;
+
+  /* Transition observers */
+  struct {
+    fsm_observer_t *head;   /* Subscribed observers */
+    fsm_observer_t **table; /* Observers grouped by from state */
+    size_t *offsets;        /* Start of the group of each state in table */
+    size_t len;             /* States with their own group, the states after
+                               them use the group of FSM_STATE_ANY */
+  } observers;
+
+  /* Definition hot-swap */
+  struct {
+    struct fsm_machine *pending; /* Definition published for the next run */
+    struct fsm_machine *retired; /* Replaced definitions to be reclaimed */
+    struct fsm_machine *next;    /* Link in the retired list */
+    const uint8_t *map;          /* State IDs map of a published definition */
+    size_t map_len;
+  } rcu;
+
+#if FSM_PACKED_LAYOUT
+  /* Storage referenced by the indices of the transitions and events */
+  struct {
+    fsm_event_t *events;
+    size_t len;
+  } events_pool;
+
+  struct {
+    fsm_eval_fn_t *evals;
+    size_t len;
+  } evals_pool;
+
+  struct {
+    fsm_action_t *actions;
+    size_t len;
+  } trans_actions_pool;
+
+  struct {
+    fsm_guard_t **guards;
+    size_t len;
+  } guards_pool;
+#endif
 } fsm_t;
 
 /* Exported constants --------------------------------------------------------*/
@@ -132,6 +495,65 @@ typedef struct {
  */
 fsm_err_t fsm_init(fsm_t *const me, uint8_t init_state, fsm_time_t get_ms);
 
+/**
+ * @brief Function to set the context of a FSM instance.
+ *
+ * The context is passed to the fsm_eval_ctx_t and fsm_fn_ctx_t callbacks, so
+ * callbacks shared by many instances know which instance called them.
+ *
+ * @param me  : Pointer to a fsm_t instance
+ * @param ctx : Context of the instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_set_context(fsm_t *const me, void *ctx);
+
+/**
+ * @brief Function to get the context of a FSM instance.
+ *
+ * @param me  : Pointer to a fsm_t instance
+ * @param ctx : Pointer to store the context of the instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_get_context(fsm_t *const me, void **ctx);
+
+/**
+ * @brief Function to deinitialize a FSM instance and free all its memory.
+ *
+ * The instance leaves its timer wheel and fleet, and the definitions published
+ * and not reclaimed yet are freed as fsm_reclaim() does. The observers, inputs,
+ * dispatch queue and recorder belong to the application and are only
+ * detached. The instance can be initialized again with fsm_init().
+ *
+ * @param me : Pointer to a fsm_t instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_BUSY: the instance is running
+ */
+fsm_err_t fsm_deinit(fsm_t *const me);
+
+/**
+ * @brief Function to get the heap memory allocated by a FSM instance.
+ *
+ * The tables grow in powers of 2, the bytes reported include the unused
+ * capacity.
+ *
+ * @param me    : Pointer to a fsm_t instance
+ * @param usage : Pointer to store the bytes allocated by each table
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_memory_usage(fsm_t *const me, fsm_memory_usage_t *usage);
+
 /**
  * @brief Function to define and add a transition betwen 2 states for a FSM
  *        instance.
@@ -147,6 +569,8 @@ fsm_err_t fsm_init(fsm_t *const me, uint8_t init_state, fsm_time_t get_ms);
  *   - FSM_ERR_OK: succeed
  *   - FSM_ERR_INVALID_PARAM: invalid parameter
  *   - FSM_ERR_NO_MEM: out of memory
+ *   - FSM_ERR_FAIL: definition loaded with FSM_LOAD_REF
+ *   - FSM_ERR_BUSY: called while the instance is running
  */
 fsm_err_t fsm_add_transition(fsm_t *const me, fsm_trans_t **trans,
                              uint8_t from_state, uint8_t next_state);
@@ -164,6 +588,43 @@ fsm_err_t fsm_add_transition(fsm_t *const me, fsm_trans_t **trans,
  */
 fsm_err_t fsm_set_event_op(fsm_t *const me, fsm_trans_t *trans, fsm_op_t op);
 
+/**
+ * @brief Function to set the mode used to evaluate the transition events.
+ *
+ * In FSM_EVAL_MODE_BITSET the events of all transitions are deduplicated into
+ * a table of unique predicates. Each predicate is evaluated at most once per
+ * fsm_run() and every transition is resolved with a mask test. The table is
+ * built here and again by the first fsm_run() after a transition or an event
+ * is added. If the FSM has more than FSM_PREDS_MAX unique predicates this
+ * function fails, and a later fsm_run() falls back to FSM_EVAL_MODE_DEFAULT,
+ * see fsm_get_eval_mode().
+ *
+ * @param me   : Pointer to a fsm_t instance
+ * @param mode : Evaluation mode
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: out of memory
+ *   - FSM_ERR_FAIL: too many unique predicates or definition loaded with
+ *     FSM_LOAD_REF
+ *   - FSM_ERR_BUSY: called while the instance is running
+ */
+fsm_err_t fsm_set_eval_mode(fsm_t *const me, fsm_eval_mode_t mode);
+
+/**
+ * @brief Function to get the mode used to evaluate the transition events, it
+ *        is FSM_EVAL_MODE_DEFAULT after a fall back.
+ *
+ * @param me   : Pointer to a fsm_t instance
+ * @param mode : Pointer to a fsm_eval_mode_t variable to store the mode
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_get_eval_mode(fsm_t *const me, fsm_eval_mode_t *mode);
+
 /**
  * @brief Function to add an event for a transition for a FSM instance.
  *
@@ -178,10 +639,118 @@ fsm_err_t fsm_set_event_op(fsm_t *const me, fsm_trans_t *trans, fsm_op_t op);
  *   - FSM_ERR_INVALID_PARAM: invalid parameter
  *   - FSM_ERR_NO_MEM: out of memory
  *   - FSM_ERR_FAIL: other error
+ *   - FSM_ERR_BUSY: called while the instance is running
  */
 fsm_err_t fsm_add_event_cmp(fsm_t *const me, fsm_trans_t *trans, int *val,
                             int cmp, fsm_eval_t eval);
 
+/**
+ * @brief Function to add an event evaluated with the context of the FSM
+ *        instance for a transition for a FSM instance.
+ *
+ * @param me    : Pointer to a fsm_t instance
+ * @param trans : Pointer to a trans_t variable to add the event
+ * @param val   : Pointer to a int variable
+ * @param cmp   : Value to compare val
+ * @param eval  : Function to evaluate val and cmp with the instance context
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: out of memory
+ *   - FSM_ERR_FAIL: other error
+ *   - FSM_ERR_BUSY: called while the instance is running
+ */
+fsm_err_t fsm_add_event_cmp_ctx(fsm_t *const me, fsm_trans_t *trans, int *val,
+                                int cmp, fsm_eval_ctx_t eval);
+
+/**
+ * @brief Function to initialize a versioned input.
+ *
+ * @param in  : Pointer to a fsm_input_t variable
+ * @param val : Initial value
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_input_init(fsm_input_t *in, int val);
+
+/**
+ * @brief Function to set the value of a versioned input. The input version is
+ *        incremented only if the value changes.
+ *
+ * @param in  : Pointer to a fsm_input_t variable
+ * @param val : New value
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_input_set(fsm_input_t *in, int val);
+
+/**
+ * @brief Function to add a versioned input event for a transition for a FSM
+ *        instance.
+ *
+ * When all the events of a transition are versioned inputs the result of
+ * their evaluation is cached, and fsm_run() evaluates them again only if any
+ * input version changed. The timeout event is always checked.
+ *
+ * @param me    : Pointer to a fsm_t instance
+ * @param trans : Pointer to a trans_t variable to add the event
+ * @param in    : Pointer to a fsm_input_t variable
+ * @param cmp   : Value to compare the input value
+ * @param eval  : Function to evaluate the input value and cmp
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: out of memory
+ *   - FSM_ERR_FAIL: other error
+ *   - FSM_ERR_BUSY: called while the instance is running
+ */
+fsm_err_t fsm_add_event_input(fsm_t *const me, fsm_trans_t *trans,
+                              fsm_input_t *in, int cmp, fsm_eval_t eval);
+
+/**
+ * @brief Function to add a versioned input event evaluated with the context
+ *        of the FSM instance for a transition for a FSM instance. The eval
+ *        can read the data behind the context, so unlike
+ *        fsm_add_event_input() the result is not cached and the transition is
+ *        evaluated in every run.
+ *
+ * @param me    : Pointer to a fsm_t instance
+ * @param trans : Pointer to a trans_t variable to add the event
+ * @param in    : Pointer to a fsm_input_t variable
+ * @param cmp   : Value to compare the input value
+ * @param eval  : Function to evaluate the input value and cmp with the
+ *                instance context
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: out of memory
+ *   - FSM_ERR_FAIL: other error
+ *   - FSM_ERR_BUSY: called while the instance is running
+ */
+fsm_err_t fsm_add_event_input_ctx(fsm_t *const me, fsm_trans_t *trans,
+                                  fsm_input_t *in, int cmp,
+                                  fsm_eval_ctx_t eval);
+
+/**
+ * @brief Function to get the cached events evaluation counters of a FSM
+ *        instance.
+ *
+ * @param me    : Pointer to a fsm_t instance
+ * @param stats : Pointer to a fsm_memo_stats_t variable to store the counters
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_get_memo_stats(fsm_t *const me, fsm_memo_stats_t *stats);
+
 /**
  * @brief Function to add a timeout event for a transition for a FSM instance.
  *
@@ -198,6 +767,66 @@ fsm_err_t fsm_add_event_cmp(fsm_t *const me, fsm_trans_t *trans, int *val,
 fsm_err_t fsm_add_event_timeout(fsm_t *const me, fsm_trans_t *trans,
                                 uint32_t timeout);
 
+/**
+ * @brief Function to add a timeout event in ticks of the time source set with
+ *        fsm_set_time_source() for a transition for a FSM instance.
+ *
+ * @param me      : Pointer to a fsm_t instance
+ * @param trans   : Pointer to a trans_t variable to add the event
+ * @param timeout : Timeout in ticks
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_add_event_timeout_ticks(fsm_t *const me, fsm_trans_t *trans,
+                                      uint32_t timeout);
+
+/**
+ * @brief Function to set a 64-bit time source for a FSM instance instead of
+ *        get_ms.
+ *
+ * The timeouts are kept in ticks, so it must be set before adding them. The
+ * timeouts in ms are converted with ticks_per_ms and saturate at UINT32_MAX
+ * ticks. fsm_run_at() still works in 32-bit ms, the timer wheel runs the
+ * instance with fsm_run_at_ticks(), and the simulator and the recorder don't
+ * accept it.
+ *
+ * @param me           : Pointer to a fsm_t instance
+ * @param get_ticks    : Pointer to function to get the time in ticks
+ * @param ticks_per_ms : Ticks in 1 ms, e.g. 1000 for a us clock
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_FAIL: the FSM instance already has transitions or a recorder
+ */
+fsm_err_t fsm_set_time_source(fsm_t *const me, fsm_time64_t get_ticks,
+                              uint32_t ticks_per_ms);
+
+/**
+ * @brief Function to set a guard expression for a transition for a FSM
+ *        instance.
+ *
+ * The expression is a tree of AND, OR and NOT nodes over comparisons and
+ * timeouts built with the FSM_EXPR_* macros. It is compiled into a flat
+ * bytecode that is evaluated with short-circuit in fsm_run(). While a guard is
+ * set, the transition events, timeout and operator are ignored.
+ *
+ * @param me    : Pointer to a fsm_t instance
+ * @param trans : Pointer to a trans_t variable to set the guard
+ * @param expr  : Pointer to the guard expression, NULL to remove the guard
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: out of memory
+ *   - FSM_ERR_FAIL: expression too long
+ *   - FSM_ERR_BUSY: called while the instance is running
+ */
+fsm_err_t fsm_set_guard(fsm_t *const me, fsm_trans_t *trans,
+                        const fsm_expr_t *expr);
+
 /**
  * @brief Function to register an action for a FSM state transition.
  *
@@ -209,10 +838,28 @@ fsm_err_t fsm_add_event_timeout(fsm_t *const me, fsm_trans_t *trans,
  * @return
  *   - FSM_ERR_OK: succeed
  *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_BUSY: called while the instance is running
  */
 fsm_err_t fsm_register_trans_action(fsm_t *const me, fsm_trans_t *trans,
                                     fsm_fn_t fn, void *arg);
 
+/**
+ * @brief Function to register an action that gets the context of the FSM
+ *        instance for a FSM state transition.
+ *
+ * @param me    : Pointer to a fsm_t instance
+ * @param trans : Pointer to a trans_t variable to check its transition
+ * @param fn    : Action function to execute when the trans events are met
+ * @param arg   : Action function argument
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_BUSY: called while the instance is running
+ */
+fsm_err_t fsm_register_trans_action_ctx(fsm_t *const me, fsm_trans_t *trans,
+                                        fsm_fn_ctx_t fn, void *arg);
+
 /**
  * @brief Function to register callbacks for a FSM state.
  *
@@ -229,12 +876,338 @@ fsm_err_t fsm_register_trans_action(fsm_t *const me, fsm_trans_t *trans,
  *   - FSM_ERR_OK: succeed
  *   - FSM_ERR_INVALID_PARAM: invalid parameter
  *   - FSM_ERR_NO_MEM: out of memory
+ *   - FSM_ERR_FAIL: definition loaded with FSM_LOAD_REF
+ *   - FSM_ERR_BUSY: called while the instance is running
  */
 fsm_err_t fsm_register_state_actions(fsm_t *const me, uint8_t state,
                                      fsm_fn_t entry_fn, void *entry_arg,
                                      fsm_fn_t update_fn, void *update_arg,
                                      fsm_fn_t exit_fn, void *exit_arg);
 
+/**
+ * @brief Function to register callbacks that get the context of the FSM
+ *        instance for a FSM state.
+ *
+ * @param me         : Pointer to a fsm_t instance
+ * @param state      : FSM state to register the callback
+ * @param entry_fn   : Callback function to execute when state is invoked
+ * @param entry_arg  : Callback function argument
+ * @param update_fn  : Callback function to execute while state is present
+ * @param update_arg : Callback function argument
+ * @param exit_fn    : Callback function to execute when state is changed
+ * @param exit_arg   : Callback function argument
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: out of memory
+ *   - FSM_ERR_FAIL: definition loaded with FSM_LOAD_REF
+ *   - FSM_ERR_BUSY: called while the instance is running
+ */
+fsm_err_t fsm_register_state_actions_ctx(fsm_t *const me, uint8_t state,
+                                         fsm_fn_ctx_t entry_fn,
+                                         void *entry_arg,
+                                         fsm_fn_ctx_t update_fn,
+                                         void *update_arg,
+                                         fsm_fn_ctx_t exit_fn,
+                                         void *exit_arg);
+
+/**
+ * @brief Function to load the whole definition of a FSM instance from a table.
+ *
+ * The rows and their events are validated in one pass before anything is
+ * stored. With FSM_LOAD_COPY the transitions, events and state actions are
+ * allocated once with their final size, and the instance can be extended with
+ * the other functions afterwards. With FSM_LOAD_REF the instance runs from the
+ * table without copying it, so a static const table stays in flash. The table
+ * must outlive the instance, and the definition can't be modified or use
+ * FSM_EVAL_MODE_BITSET.
+ *
+ * @param me    : Pointer to a fsm_t instance without transitions and actions
+ * @param table : Pointer to the table
+ * @param mode  : FSM_LOAD_COPY or FSM_LOAD_REF
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter or row
+ *   - FSM_ERR_NO_MEM: out of memory
+ *   - FSM_ERR_FAIL: the instance already has a definition
+ *   - FSM_ERR_BUSY: called while the instance is running
+ */
+fsm_err_t fsm_load(fsm_t *const me, const fsm_table_t *table,
+                   fsm_load_mode_t mode);
+
+/**
+ * @brief Function to register an asynchronous action for a FSM state.
+ *
+ * The action is called inside fsm_run() after the entry action of the state
+ * and starts a long operation, e.g. a flash erase or a bus transfer. If it
+ * returns true the instance stays in an in-progress substate: the update
+ * action and the events of the state are held until the operation is
+ * completed with fsm_async_complete(). The timeouts of the state still count
+ * from its entry, and a transition enabled by its timeout alone leaves the
+ * state and aborts the operation, so its late completion fails. The
+ * transitions with a guard expression wait for the completion. The action is
+ * never deferred to the dispatch queue.
+ *
+ * @param me    : Pointer to a fsm_t instance
+ * @param state : FSM state
+ * @param fn    : Asynchronous action, NULL to remove it
+ * @param arg   : Action argument
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: out of memory
+ *   - FSM_ERR_BUSY: called while the instance is running
+ */
+fsm_err_t fsm_register_state_async(fsm_t *const me, uint8_t state,
+                                   fsm_async_fn_t fn, void *arg);
+
+/**
+ * @brief Function to set the function called when an asynchronous operation
+ *        of a FSM instance completes, e.g. to wake up the loop that runs it.
+ *
+ * @param me     : Pointer to a fsm_t instance
+ * @param notify : Function called by fsm_async_complete() in the context of
+ *                 the caller, NULL for none
+ * @param arg    : Function argument
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_set_async_notify(fsm_t *const me, fsm_async_notify_t notify,
+                               void *arg);
+
+/**
+ * @brief Function to complete the asynchronous operation of a FSM instance.
+ *        It can be called from other thread or from an ISR.
+ *
+ * The result is stored in the input returned by fsm_get_async_result() and
+ * the transitions of the state are evaluated in the next run. Only the first
+ * completion of the operation succeeds.
+ *
+ * @param op     : Handle passed to the asynchronous action
+ * @param result : Result of the operation
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_FAIL: the operation is not pending
+ */
+fsm_err_t fsm_async_complete(fsm_async_t op, int result);
+
+/**
+ * @brief Function to get the versioned input with the result of the last
+ *        asynchronous operation of a FSM instance, to be used in the events
+ *        of the transitions.
+ *
+ * @param me     : Pointer to a fsm_t instance
+ * @param result : Pointer to store the pointer to the input
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_get_async_result(fsm_t *const me, fsm_input_t **result);
+
+/**
+ * @brief Function to set the dispatch queue of a FSM instance.
+ *
+ * With a dispatch queue the entry, update, exit and transition actions are
+ * not executed inside fsm_run(). They are added to the queue in the same
+ * order and executed by fsm_dispatch_drain(). The state changes don't depend
+ * on the actions, so fsm_run() takes a bounded time.
+ *
+ * @param me       : Pointer to a fsm_t instance
+ * @param dispatch : Pointer to a fsm_dispatch_t instance, NULL to execute the
+ *                   actions inside fsm_run()
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_set_dispatch(fsm_t *const me, struct fsm_dispatch *dispatch);
+
+/**
+ * @brief Function to set the latency budgets of a FSM state.
+ *
+ * The dwell budget is checked on each fsm_run() with the time already read
+ * for the run, and it is reported once per visit of the state. The action
+ * budget applies to the entry, update, exit and transition actions of the
+ * state executed inside fsm_run(); they are measured with the time source set
+ * by fsm_set_budget_handler() only while the state has an action budget.
+ *
+ * @param me           : Pointer to a fsm_t instance
+ * @param state        : FSM state
+ * @param dwell_ms     : Max time in the state in ms, 0 for no budget
+ * @param action_ticks : Max time of each action in ticks of the time source,
+ *                       0 for no budget
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: out of memory
+ *   - FSM_ERR_BUSY: called while the instance is running
+ */
+fsm_err_t fsm_set_state_budget(fsm_t *const me, uint8_t state,
+                               uint32_t dwell_ms, uint32_t action_ticks);
+
+/**
+ * @brief Function to set the handler of the budget violations of a FSM
+ *        instance.
+ *
+ * @param me        : Pointer to a fsm_t instance
+ * @param fn        : Function called on each violation, can be NULL to only
+ *                    count them
+ * @param arg       : Function argument
+ * @param get_ticks : Time source of the action budgets, e.g. in us. NULL to
+ *                    use get_ms
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_set_budget_handler(fsm_t *const me, fsm_violation_fn_t fn,
+                                 void *arg, fsm_time_t get_ticks);
+
+/**
+ * @brief Function to get the budget violation counters of a FSM instance.
+ *
+ * @param me    : Pointer to a fsm_t instance
+ * @param stats : Pointer to a fsm_budget_stats_t variable to store the
+ *                counters
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_get_budget_stats(fsm_t *const me, fsm_budget_stats_t *stats);
+
+/**
+ * @brief Function to subscribe an observer to the transitions of a FSM
+ *        instance.
+ *
+ * The observer function is called from fsm_run() after each transition that
+ * matches the state filters. The observers are grouped by from state when
+ * they are subscribed, so each transition visits only the observers of its
+ * state, and an instance without observers pays a single branch.
+ *
+ * @param me         : Pointer to a fsm_t instance
+ * @param observer   : Pointer to a fsm_observer_t variable, must be valid
+ *                     while subscribed
+ * @param from_state : State the transition comes from, FSM_STATE_ANY for any
+ * @param to_state   : State the transition goes to, FSM_STATE_ANY for any
+ * @param fn         : Function called after the transition
+ * @param arg        : Function argument
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: out of memory
+ *   - FSM_ERR_BUSY: called while the instance is running
+ */
+fsm_err_t fsm_subscribe(fsm_t *const me, fsm_observer_t *observer,
+                        int from_state, int to_state, fsm_observer_fn_t fn,
+                        void *arg);
+
+/**
+ * @brief Function to unsubscribe an observer from the transitions of a FSM
+ *        instance.
+ *
+ * @param me       : Pointer to a fsm_t instance
+ * @param observer : Pointer to a subscribed fsm_observer_t variable
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: out of memory
+ *   - FSM_ERR_BUSY: called while the instance is running
+ */
+fsm_err_t fsm_unsubscribe(fsm_t *const me, fsm_observer_t *observer);
+
+/**
+ * @brief Function to set the input recorder of a FSM instance.
+ *
+ * The inputs compared by the events and guards of the instance are added to
+ * the recorder, and each fsm_run() logs its time and the inputs that changed.
+ * Set it again after the definition changes. The log keeps the time in ms,
+ * so an instance with a time source set with fsm_set_time_source() can't be
+ * recorded.
+ *
+ * @param me       : Pointer to a fsm_t instance
+ * @param recorder : Pointer to a fsm_recorder_t instance, NULL to stop
+ *                   recording
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter or instance with a time source
+ *   - FSM_ERR_NO_MEM: out of memory
+ *   - FSM_ERR_BUSY: called while the instance is running
+ */
+fsm_err_t fsm_set_recorder(fsm_t *const me, struct fsm_recorder *recorder);
+
+/**
+ * @brief Function to get a consistent snapshot of the state of a FSM instance.
+ *
+ * The snapshot is published atomically on each transition, so it can be read
+ * from other threads without locks while the instance is running.
+ *
+ * @param me   : Pointer to a fsm_t instance
+ * @param snap : Pointer to a fsm_snapshot_t variable to store the snapshot
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_get_snapshot(const fsm_t *const me, fsm_snapshot_t *snap);
+
+/**
+ * @brief Function to publish a new definition for a running FSM instance.
+ *
+ * The definition is taken from def, an instance built with fsm_init() and the
+ * fsm_add_* functions that is never run. The FSM instance adopts it at the
+ * start of its next fsm_run() with a single atomic exchange, so it can be
+ * called from other thread without stopping the instance. The current state is
+ * translated with state_map, states outside the map keep their ID. The
+ * asynchronous actions and the budgets of the states are part of the
+ * definition, their handlers are not. The replaced definition is moved to def
+ * and retired until fsm_reclaim() is called. Publishing again before the
+ * previous definition is adopted retires the previous one.
+ *
+ * @param me        : Pointer to a fsm_t instance
+ * @param def       : Pointer to a fsm_t instance with the new definition
+ * @param state_map : New ID of each state, must be valid until adopted. NULL
+ *                    to keep the IDs
+ * @param map_len   : Number of elements of state_map
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_publish(fsm_t *const me, fsm_t *def, const uint8_t *state_map,
+                      size_t map_len);
+
+/**
+ * @brief Function to take a retired definition of a FSM instance.
+ *
+ * A definition is retired after the FSM instance stops using it, so its
+ * memory can be freed while the instance is running. The tables of the
+ * retired definition are freed and the fsm_t instance that was passed to
+ * fsm_publish() is returned, so it can be reused or released. It must be
+ * called from a single thread, e.g. the one that publishes the definitions.
+ *
+ * @param me  : Pointer to a fsm_t instance
+ * @param def : Pointer to store the reclaimed fsm_t instance, NULL if there
+ *              are no retired definitions
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_reclaim(fsm_t *const me, fsm_t **def);
+
 /**
  * @brief Function to run FSM instance.
  *
@@ -243,9 +1216,44 @@ fsm_err_t fsm_register_state_actions(fsm_t *const me, uint8_t state,
  * @return
  *   - FSM_ERR_OK: succeed
  *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_BUSY: the instance is already running, e.g. called from one of
+ *     its actions
+ *   - FSM_ERR_NO_MEM: the dispatch queue is full, some actions were dropped
  */
 fsm_err_t fsm_run(fsm_t *const me);
 
+/**
+ * @brief Function to run FSM instance at a given time instead of the time
+ *        returned by get_ms, e.g. a virtual time of a simulation.
+ *
+ * @param me     : Pointer to a fsm_t instance
+ * @param now_ms : Current time in ms
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_BUSY: the instance is already running, e.g. called from one of
+ *     its actions
+ *   - FSM_ERR_NO_MEM: the dispatch queue is full, some actions were dropped
+ */
+fsm_err_t fsm_run_at(fsm_t *const me, uint32_t now_ms);
+
+/**
+ * @brief Function to run FSM instance at a given time in ticks of the time
+ *        source set with fsm_set_time_source().
+ *
+ * @param me        : Pointer to a fsm_t instance
+ * @param now_ticks : Current time in ticks
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_BUSY: the instance is already running, e.g. called from one of
+ *     its actions
+ *   - FSM_ERR_NO_MEM: the dispatch queue is full, some actions were dropped
+ */
+fsm_err_t fsm_run_at_ticks(fsm_t *const me, uint64_t now_ticks);
+
 #ifdef __cplusplus
 }
 #endif
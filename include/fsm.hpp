@@ -0,0 +1,311 @@
+/**
+ ******************************************************************************
+ * @file           : fsm.hpp
+ * @author         : Mauricio Barroso Benavides
+ * @date           : Oct 18, 2026
+ * @brief          : C++20 coroutine awaitables to wait for the states and
+ *                   transitions of FSM instances
+ ******************************************************************************
+ * @attention
+ *
+ * MIT License
+ *
+ * Copyright (c) 2026 Mauricio Barroso Benavides
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef FSM_HPP_
+#define FSM_HPP_
+
+/* Includes ------------------------------------------------------------------*/
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+
+#include "fsm.h"
+
+namespace fsm {
+
+/* Exported types ------------------------------------------------------------*/
+class machine;
+
+/**
+ * @brief Coroutine type that starts immediately and frees its frame when it
+ *        finishes. Coroutines that co_await the FSM awaitables can return it.
+ */
+struct task {
+  struct promise_type {
+    task get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+
+/**
+ * @brief Awaitable that suspends the coroutine until the FSM instance takes a
+ *        transition that matches the state filters or the timeout expires.
+ *
+ * The awaitable is stored in the coroutine frame and linked in the list of
+ * the machine, so a wait doesn't allocate memory. co_await returns true if the
+ * transition was taken and false if the timeout expired.
+ */
+class transition_awaiter {
+ public:
+  transition_awaiter(machine &m, int from_state, int to_state, bool timed,
+                     uint32_t timeout_ms, bool in_state) noexcept
+      : machine_(m),
+        from_state_(from_state),
+        to_state_(to_state),
+        timed_(timed),
+        timeout_ms_(timeout_ms),
+        in_state_(in_state) {}
+
+  bool await_ready() noexcept;
+  void await_suspend(std::coroutine_handle<> handle) noexcept;
+  bool await_resume() const noexcept { return taken_; }
+
+ private:
+  friend class machine;
+
+  bool matches(uint8_t from_state, uint8_t to_state) const noexcept {
+    return (from_state_ == FSM_STATE_ANY || from_state_ == from_state) &&
+           (to_state_ == FSM_STATE_ANY || to_state_ == to_state);
+  }
+
+  machine &machine_;
+  int from_state_;
+  int to_state_;
+  bool timed_;
+  uint32_t timeout_ms_;
+  uint32_t deadline_ms_ = 0;
+  bool in_state_; /* Ready if the machine is already in to_state */
+  bool taken_ = false;
+  std::coroutine_handle<> handle_;
+  transition_awaiter *next_ = nullptr;
+};
+
+/**
+ * @brief Wrapper of a FSM instance that resumes the coroutines waiting for its
+ *        states and transitions.
+ *
+ * The waits are taken by an observer subscribed to the instance, right after
+ * the transition. When the machine runs the instance, with run(), run_at() or
+ * run_at_ticks(), the coroutines are resumed after fsm_run() returns, so they
+ * can call fsm_run() or change the instance. They see it in the new state
+ * before its entry action, which runs in the next run. When the instance is
+ * run from C code they are resumed inside fsm_run(), while it is running.
+ * The timeouts of the timed waits are checked by run(), run_at(),
+ * run_at_ticks() and check_timeouts(). The instances with a time source set
+ * with fsm_set_time_source() are run in ticks of that source.
+ */
+class machine {
+ public:
+  explicit machine(fsm_t &fsm) noexcept : fsm_(fsm) {
+    status_ = fsm_subscribe(&fsm_, &observer_, FSM_STATE_ANY, FSM_STATE_ANY,
+                            on_transition, this);
+  }
+
+  ~machine() {
+    if (status_ == FSM_ERR_OK) {
+      fsm_unsubscribe(&fsm_, &observer_);
+    }
+  }
+
+  machine(const machine &) = delete;
+  machine &operator=(const machine &) = delete;
+
+  /* Result of the subscription to the FSM instance */
+  fsm_err_t status() const noexcept { return status_; }
+
+  fsm_t &get() noexcept { return fsm_; }
+
+  /* Wait until the instance is in state */
+  transition_awaiter enter(uint8_t state) noexcept {
+    return {*this, FSM_STATE_ANY, state, false, 0, true};
+  }
+
+  transition_awaiter enter(uint8_t state, uint32_t timeout_ms) noexcept {
+    return {*this, FSM_STATE_ANY, state, true, timeout_ms, true};
+  }
+
+  /* Wait for the next transition from from_state to to_state, any of them
+  can be FSM_STATE_ANY */
+  transition_awaiter transition(int from_state, int to_state) noexcept {
+    return {*this, from_state, to_state, false, 0, false};
+  }
+
+  transition_awaiter transition(int from_state, int to_state,
+                                uint32_t timeout_ms) noexcept {
+    return {*this, from_state, to_state, true, timeout_ms, false};
+  }
+
+  fsm_err_t run() noexcept {
+    if (fsm_.time64.get_ticks != nullptr) {
+      return run_at_ticks(fsm_.time64.get_ticks());
+    }
+
+    return run_at(fsm_.get_ms != nullptr ? fsm_.get_ms() : now_ms_);
+  }
+
+  /* Only for instances without a 64-bit time source, their ms time would
+  wrap around */
+  fsm_err_t run_at(uint32_t now_ms) noexcept {
+    if (fsm_.time64.get_ticks != nullptr) {
+      return FSM_ERR_INVALID_PARAM;
+    }
+
+    now_ms_ = now_ms;
+    in_run_ = true;
+    fsm_err_t ret = fsm_run_at(&fsm_, now_ms);
+    in_run_ = false;
+    resume_ready();
+    check_timeouts(now_ms);
+    return ret;
+  }
+
+  fsm_err_t run_at_ticks(uint64_t now_ticks) noexcept {
+    uint32_t now_ms =
+        static_cast<uint32_t>(now_ticks / fsm_.time64.ticks_per_ms);
+    now_ms_ = now_ms;
+    in_run_ = true;
+    fsm_err_t ret = fsm_run_at_ticks(&fsm_, now_ticks);
+    in_run_ = false;
+    resume_ready();
+    check_timeouts(now_ms);
+    return ret;
+  }
+
+  /* Resume the timed waits whose timeout expired */
+  void check_timeouts(uint32_t now_ms) noexcept {
+    now_ms_ = now_ms;
+    transition_awaiter *expired = nullptr;
+    transition_awaiter **link = &waiters_;
+
+    while (*link != nullptr) {
+      transition_awaiter *w = *link;
+      if (w->timed_ && static_cast<int32_t>(now_ms - w->deadline_ms_) >= 0) {
+        *link = w->next_;
+        w->next_ = expired;
+        expired = w;
+      } else {
+        link = &w->next_;
+      }
+    }
+
+    resume(expired);
+  }
+
+ private:
+  friend class transition_awaiter;
+
+  static void on_transition(fsm_t *, uint8_t from_state, uint8_t to_state,
+                            void *arg) {
+    machine *me = static_cast<machine *>(arg);
+    transition_awaiter *taken = nullptr;
+    transition_awaiter **link = &me->waiters_;
+
+    /* Unlink the matching waits first, the resumed coroutines can wait
+    again */
+    while (*link != nullptr) {
+      transition_awaiter *w = *link;
+      if (w->matches(from_state, to_state)) {
+        *link = w->next_;
+        w->taken_ = true;
+        w->next_ = taken;
+        taken = w;
+      } else {
+        link = &w->next_;
+      }
+    }
+
+    /* Inside a run of the machine they wait until fsm_run() returns */
+    if (me->in_run_ && taken != nullptr) {
+      transition_awaiter *tail = taken;
+      while (tail->next_ != nullptr) {
+        tail = tail->next_;
+      }
+      tail->next_ = me->ready_;
+      me->ready_ = taken;
+      return;
+    }
+
+    resume(taken);
+  }
+
+  void resume_ready() noexcept {
+    transition_awaiter *ready = ready_;
+    ready_ = nullptr;
+    resume(ready);
+  }
+
+  static void resume(transition_awaiter *list) noexcept {
+    /* The awaiter is destroyed with its frame, take the link before */
+    while (list != nullptr) {
+      transition_awaiter *next = list->next_;
+      list->handle_.resume();
+      list = next;
+    }
+  }
+
+  uint32_t now() const noexcept {
+    if (fsm_.time64.get_ticks != nullptr) {
+      return static_cast<uint32_t>(fsm_.time64.get_ticks() /
+                                   fsm_.time64.ticks_per_ms);
+    }
+
+    return fsm_.get_ms != nullptr ? fsm_.get_ms() : now_ms_;
+  }
+
+  fsm_t &fsm_;
+  fsm_observer_t observer_{};
+  fsm_err_t status_;
+  transition_awaiter *waiters_ = nullptr;
+  transition_awaiter *ready_ = nullptr; /* Taken in the run in progress */
+  bool in_run_ = false;                 /* fsm_run() called by the machine */
+  uint32_t now_ms_ = 0;                 /* Time of the last run */
+};
+
+/* Exported functions --------------------------------------------------------*/
+inline bool transition_awaiter::await_ready() noexcept {
+  if (in_state_ && to_state_ == machine_.fsm_.current_state) {
+    taken_ = true;
+  }
+
+  return taken_;
+}
+
+inline void transition_awaiter::await_suspend(
+    std::coroutine_handle<> handle) noexcept {
+  handle_ = handle;
+  deadline_ms_ = machine_.now() + timeout_ms_;
+  next_ = machine_.waiters_;
+  machine_.waiters_ = this;
+}
+
+} /* namespace fsm */
+
+#endif /* FSM_HPP_ */
+
+/***************************** END OF FILE ************************************/
@@ -0,0 +1,224 @@
+/**
+ ******************************************************************************
+ * @file           : fsm_bus.h
+ * @author         : Mauricio Barroso Benavides
+ * @date           : Oct 18, 2026
+ * @brief          : This file contains all the definitios, data types and
+ *                   function prototypes for fsm_bus.c file
+ ******************************************************************************
+ * @attention
+ *
+ * MIT License
+ *
+ * Copyright (c) 2026 Mauricio Barroso Benavides
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef FSM_BUS_H_
+#define FSM_BUS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm.h"
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+  fsm_input_t *input; /* Input of the target instance set by the event */
+  int val;
+  size_t rank; /* Position of the target instance in the delivery order */
+  size_t next; /* Next event queued for the same instance */
+} fsm_bus_event_t;
+
+/* Events queued for an instance, indexes in the queue, SIZE_MAX if none */
+typedef struct {
+  size_t head;
+  size_t tail;
+} fsm_bus_list_t;
+
+typedef struct {
+  fsm_t *from;
+  fsm_t *to;
+} fsm_bus_edge_t;
+
+typedef struct {
+  const fsm_input_t *input;
+  uint32_t pass; /* Pass where the input was set, 0 for a free mark */
+} fsm_bus_mark_t;
+
+typedef struct fsm_bus {
+  struct {
+    fsm_t **fsms;    /* Instances in topological order */
+    fsm_bus_list_t *pending; /* Events queued for each instance */
+    size_t len;
+  } nodes;
+
+  struct {
+    fsm_bus_edge_t *edges;
+    size_t len;
+  } edges;
+
+  struct {
+    fsm_bus_event_t *events; /* Batch of events in emission order */
+    size_t len;
+    size_t size;
+  } queue;
+
+  /* Inputs set in the current pass, open addressing by address */
+  struct {
+    fsm_bus_mark_t *marks;
+    size_t size; /* Power of 2, greater than the queue size */
+    uint32_t pass;
+  } delivered;
+
+  uint32_t dropped; /* Events lost because the queue was full */
+} fsm_bus_t;
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+/**
+ * @brief Function to initialize an event bus.
+ *
+ * An event bus connects FSM instances whose actions emit events to other
+ * instances. The events are values for the versioned inputs of the targets,
+ * queued in a single buffer and delivered by fsm_bus_run(), which runs the
+ * instances in topological order so a cascade settles in one pass. The bus
+ * and its instances must be used from a single thread.
+ *
+ * @param me   : Pointer to a fsm_bus_t instance
+ * @param size : Max number of queued events
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: out of memory
+ */
+fsm_err_t fsm_bus_init(fsm_bus_t *const me, size_t size);
+
+/**
+ * @brief Function to deinitialize an event bus. The queued events are
+ *        discarded.
+ *
+ * @param me : Pointer to a fsm_bus_t instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_bus_deinit(fsm_bus_t *const me);
+
+/**
+ * @brief Function to add a FSM instance to an event bus.
+ *
+ * @param me  : Pointer to a fsm_bus_t instance
+ * @param fsm : Pointer to a fsm_t instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter or already added to a bus
+ *   - FSM_ERR_NO_MEM: out of memory
+ *   - FSM_ERR_BUSY: there are queued events
+ */
+fsm_err_t fsm_bus_add(fsm_bus_t *const me, fsm_t *fsm);
+
+/**
+ * @brief Function to remove a FSM instance from an event bus. Its connections
+ *        and the events queued for it are dropped. fsm_deinit() removes the
+ *        instance from its bus. It must not be called while the bus runs.
+ *
+ * @param me  : Pointer to a fsm_bus_t instance
+ * @param fsm : Pointer to a fsm_t instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter or instance not added
+ */
+fsm_err_t fsm_bus_remove(fsm_bus_t *const me, fsm_t *fsm);
+
+/**
+ * @brief Function to declare that a FSM instance emits events to other, so
+ *        the source runs before the target in each pass.
+ *
+ * @param me   : Pointer to a fsm_bus_t instance
+ * @param from : Pointer to the source fsm_t instance
+ * @param to   : Pointer to the target fsm_t instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter or instances not added
+ *   - FSM_ERR_NO_MEM: out of memory
+ *   - FSM_ERR_BUSY: there are queued events
+ *   - FSM_ERR_FAIL: the connection makes a cycle
+ */
+fsm_err_t fsm_bus_connect(fsm_bus_t *const me, fsm_t *from, fsm_t *to);
+
+/**
+ * @brief Function to emit an event to a FSM instance, usually from an action
+ *        of other instance of the bus.
+ *
+ * @param me     : Pointer to a fsm_bus_t instance
+ * @param target : Pointer to the target fsm_t instance
+ * @param input  : Pointer to the versioned input of the target to set
+ * @param val    : New value of the input
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter or target not added
+ *   - FSM_ERR_NO_MEM: the queue is full, the event is dropped
+ */
+fsm_err_t fsm_bus_emit(fsm_bus_t *const me, fsm_t *target, fsm_input_t *input,
+                       int val);
+
+/**
+ * @brief Function to run one pass of the FSM instances of an event bus.
+ *
+ * Each instance gets its queued events with fsm_input_set() and then runs
+ * with fsm_run(), in topological order, so the events emitted to the
+ * following instances are delivered in the same pass. Events to an instance
+ * that already ran, and a second event to an input already set in the pass,
+ * are kept in order for the next pass.
+ *
+ * @param me        : Pointer to a fsm_bus_t instance
+ * @param delivered : Pointer to store the number of events delivered, can be
+ *                    NULL
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: the queue was full, some events emitted in this pass
+ *     were dropped
+ */
+fsm_err_t fsm_bus_run(fsm_bus_t *const me, size_t *delivered);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FSM_BUS_H_ */
+
+/***************************** END OF FILE ************************************/
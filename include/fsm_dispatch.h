@@ -0,0 +1,152 @@
+/**
+ ******************************************************************************
+ * @file           : fsm_dispatch.h
+ * @author         : Mauricio Barroso Benavides
+ * @date           : Oct 18, 2026
+ * @brief          : This file contains all the definitios, data types and
+ *                   function prototypes for fsm_dispatch.c file
+ ******************************************************************************
+ * @attention
+ *
+ * MIT License
+ *
+ * Copyright (c) 2026 Mauricio Barroso Benavides
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef FSM_DISPATCH_H_
+#define FSM_DISPATCH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm.h"
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+  fsm_action_t action;
+  void *ctx; /* Context of the FSM instance for the fsm_fn_ctx_t actions */
+} fsm_dispatch_record_t;
+
+typedef struct fsm_dispatch {
+  fsm_dispatch_record_t *records; /* Ring of pending actions */
+  size_t len;            /* Number of records, power of 2 */
+  size_t head;           /* Next record to write, owned by the producer */
+  size_t tail;           /* Next record to execute, owned by the consumers */
+  uint32_t dropped;      /* Actions lost because the ring was full */
+} fsm_dispatch_t;
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+/**
+ * @brief Function to initialize a dispatch queue.
+ *
+ * A dispatch queue stores the actions of the FSM instances attached with
+ * fsm_set_dispatch() instead of executing them inside fsm_run(). The queue
+ * can be shared by several instances run from the same thread and drained
+ * from that thread or from other threads.
+ *
+ * @param me  : Pointer to a fsm_dispatch_t instance
+ * @param len : Number of records, must be a power of 2
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: out of memory
+ */
+fsm_err_t fsm_dispatch_init(fsm_dispatch_t *const me, size_t len);
+
+/**
+ * @brief Function to deinitialize a dispatch queue. The pending actions are
+ *        discarded.
+ *
+ * @param me : Pointer to a fsm_dispatch_t instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_dispatch_deinit(fsm_dispatch_t *const me);
+
+/**
+ * @brief Function to add an action to a dispatch queue. Only one thread can
+ *        add actions to a queue.
+ *
+ * @param me  : Pointer to a fsm_dispatch_t instance
+ * @param fn  : Action function
+ * @param arg : Action function argument
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: the queue is full, the action is dropped
+ */
+fsm_err_t fsm_dispatch_push(fsm_dispatch_t *const me, fsm_fn_t fn, void *arg);
+
+/**
+ * @brief Function to add an action that gets the context of a FSM instance to
+ *        a dispatch queue. Only one thread can add actions to a queue.
+ *
+ * @param me  : Pointer to a fsm_dispatch_t instance
+ * @param fn  : Action function
+ * @param ctx : Context of the FSM instance
+ * @param arg : Action function argument
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: the queue is full, the action is dropped
+ */
+fsm_err_t fsm_dispatch_push_ctx(fsm_dispatch_t *const me, fsm_fn_ctx_t fn,
+                                void *ctx, void *arg);
+
+/**
+ * @brief Function to execute the pending actions of a dispatch queue.
+ *
+ * It can be called concurrently from several worker threads. A single
+ * consumer executes the actions in the same order that they were produced.
+ *
+ * @param me       : Pointer to a fsm_dispatch_t instance
+ * @param max      : Max number of actions to execute, 0 for no limit
+ * @param executed : Pointer to store the number of actions executed, can be
+ *                   NULL
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_dispatch_drain(fsm_dispatch_t *const me, size_t max,
+                             size_t *executed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FSM_DISPATCH_H_ */
+
+/***************************** END OF FILE ************************************/
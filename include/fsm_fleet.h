@@ -0,0 +1,171 @@
+/**
+ ******************************************************************************
+ * @file           : fsm_fleet.h
+ * @author         : Mauricio Barroso Benavides
+ * @date           : Oct 18, 2026
+ * @brief          : This file contains all the definitios, data types and
+ *                   function prototypes for fsm_fleet.c file
+ ******************************************************************************
+ * @attention
+ *
+ * MIT License
+ *
+ * Copyright (c) 2026 Mauricio Barroso Benavides
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef FSM_FLEET_H_
+#define FSM_FLEET_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm.h"
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported types ------------------------------------------------------------*/
+typedef void (*fsm_fleet_fn_t)(fsm_t *fsm, void *arg);
+
+typedef struct fsm_fleet {
+  fsm_fleet_link_t *lists; /* Sentinels of the lists of each state, the last
+                              one for the states out of range */
+  size_t *counts;          /* Instances in each list */
+  size_t len;              /* States with their own list */
+} fsm_fleet_t;
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+/**
+ * @brief Function to initialize a fleet.
+ *
+ * A fleet groups many FSM instances by their current state. Each registered
+ * instance is linked in the list of its state and fsm_run() moves it to the
+ * list of the next state when it makes a transition, so counting or visiting
+ * the instances in a state costs as much as the instances found and not the
+ * size of the fleet.
+ *
+ * @param me  : Pointer to a fsm_fleet_t instance
+ * @param len : Number of states with their own list, up to 256. The instances
+ *              in greater states share an extra list
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: out of memory
+ */
+fsm_err_t fsm_fleet_init(fsm_fleet_t *const me, size_t len);
+
+/**
+ * @brief Function to deinitialize a fleet. All the registered FSM instances
+ *        are removed.
+ *
+ * @param me : Pointer to a fsm_fleet_t instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_fleet_deinit(fsm_fleet_t *const me);
+
+/**
+ * @brief Function to register a FSM instance in a fleet.
+ *
+ * @param me  : Pointer to a fsm_fleet_t instance
+ * @param fsm : Pointer to a fsm_t instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_fleet_add(fsm_fleet_t *const me, fsm_t *fsm);
+
+/**
+ * @brief Function to remove a FSM instance from a fleet.
+ *
+ * @param me  : Pointer to a fsm_fleet_t instance
+ * @param fsm : Pointer to a fsm_t instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_fleet_remove(fsm_fleet_t *const me, fsm_t *fsm);
+
+/**
+ * @brief Function to get the number of FSM instances of a fleet in a state.
+ *
+ * @param me    : Pointer to a fsm_fleet_t instance
+ * @param state : State to count, lower than the len of the fleet
+ * @param count : Pointer to store the number of instances
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_fleet_count(fsm_fleet_t *const me, uint8_t state,
+                          size_t *count);
+
+/**
+ * @brief Function to call a function for each FSM instance of a fleet in a
+ *        state.
+ *
+ * The function can run the instance or any other of the fleet. The instances
+ * that enter the state while visiting it are not visited and the ones that
+ * leave it before their turn are skipped.
+ *
+ * @param me    : Pointer to a fsm_fleet_t instance
+ * @param state : State to visit, lower than the len of the fleet
+ * @param fn    : Function called with each instance
+ * @param arg   : Argument passed to the function
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_fleet_foreach(fsm_fleet_t *const me, uint8_t state,
+                            fsm_fleet_fn_t fn, void *arg);
+
+/**
+ * @brief Function to move a FSM instance registered in a fleet to the list of
+ *        its current state. It is called by fsm_run().
+ *
+ * @param me  : Pointer to a fsm_fleet_t instance
+ * @param fsm : Pointer to a fsm_t instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_fleet_update(fsm_fleet_t *const me, fsm_t *fsm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FSM_FLEET_H_ */
+
+/***************************** END OF FILE ************************************/
@@ -0,0 +1,181 @@
+/**
+ ******************************************************************************
+ * @file           : fsm_linux.h
+ * @author         : Mauricio Barroso Benavides
+ * @date           : Oct 18, 2026
+ * @brief          : This file contains all the definitios, data types and
+ *                   function prototypes for fsm_linux.c file
+ ******************************************************************************
+ * @attention
+ *
+ * MIT License
+ *
+ * Copyright (c) 2026 Mauricio Barroso Benavides
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef FSM_LINUX_H_
+#define FSM_LINUX_H_
+
+#if defined(__linux__)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm.h"
+#include "fsm_wheel.h"
+
+/* Exported macro ------------------------------------------------------------*/
+#define FSM_LINUX_EVENTS_MAX 16 /* Max events handled per epoll_wait() */
+
+/* Exported types ------------------------------------------------------------*/
+typedef void (*fsm_linux_fd_fn_t)(int fd, void *arg);
+
+typedef struct {
+  int fd;
+  fsm_t *fsm;           /* Instance to run when fd is readable */
+  fsm_linux_fd_fn_t fn; /* Reads fd and updates the instance events */
+  void *arg;
+} fsm_linux_source_t;
+
+typedef struct {
+  int epoll_fd;
+  int timer_fd;
+  fsm_wheel_t wheel;
+} fsm_linux_loop_t;
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+/**
+ * @brief Function to get the CLOCK_MONOTONIC time in ms. It can be used as the
+ *        time source of the FSM instances registered in a loop.
+ *
+ * @return Time in ms
+ */
+uint32_t fsm_linux_get_ms(void);
+
+/**
+ * @brief Function to initialize an event loop.
+ *
+ * The loop blocks in epoll_wait() until a registered file descriptor is
+ * readable or the timerfd armed to the next state timeout of the registered
+ * instances expires, so fsm_run() is called only when there is work.
+ *
+ * @param me      : Pointer to a fsm_linux_loop_t instance
+ * @param len     : Number of slots of the timer wheel, must be a power of 2
+ * @param tick_ms : Time covered by each slot of the timer wheel in ms
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: out of memory
+ *   - FSM_ERR_FAIL: epoll or timerfd error
+ */
+fsm_err_t fsm_linux_loop_init(fsm_linux_loop_t *const me, size_t len,
+                              uint32_t tick_ms);
+
+/**
+ * @brief Function to deinitialize an event loop.
+ *
+ * @param me : Pointer to a fsm_linux_loop_t instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_linux_loop_deinit(fsm_linux_loop_t *const me);
+
+/**
+ * @brief Function to register a FSM instance in an event loop. The instance
+ *        is run at fsm_linux_get_ms(), or at the current time of the time
+ *        source set with fsm_set_time_source(), so its get_ms is not used.
+ *
+ * @param me  : Pointer to a fsm_linux_loop_t instance
+ * @param fsm : Pointer to a fsm_t instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_linux_loop_add(fsm_linux_loop_t *const me, fsm_t *fsm);
+
+/**
+ * @brief Function to register a file descriptor (eventfd, socket, pipe, etc.)
+ *        that feeds the events of a FSM instance.
+ *
+ * @param me  : Pointer to a fsm_linux_loop_t instance
+ * @param src : Pointer to a fsm_linux_source_t variable, it must be valid
+ *              while it is registered
+ * @param fd  : File descriptor to wait for
+ * @param fsm : Pointer to the fsm_t instance to run when fd is readable
+ * @param fn  : Function to read fd, called before running the instance
+ * @param arg : Function argument
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_FAIL: epoll error
+ */
+fsm_err_t fsm_linux_loop_add_fd(fsm_linux_loop_t *const me,
+                                fsm_linux_source_t *src, int fd, fsm_t *fsm,
+                                fsm_linux_fd_fn_t fn, void *arg);
+
+/**
+ * @brief Function to remove a file descriptor from an event loop.
+ *
+ * @param me  : Pointer to a fsm_linux_loop_t instance
+ * @param src : Pointer to the fsm_linux_source_t variable registered
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_FAIL: epoll error
+ */
+fsm_err_t fsm_linux_loop_remove_fd(fsm_linux_loop_t *const me,
+                                   fsm_linux_source_t *src);
+
+/**
+ * @brief Function to wait for work and run the FSM instances that have it.
+ *
+ * @param me         : Pointer to a fsm_linux_loop_t instance
+ * @param timeout_ms : Max time to wait in ms, -1 to wait forever
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_FAIL: epoll or timerfd error
+ */
+fsm_err_t fsm_linux_loop_run_once(fsm_linux_loop_t *const me, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __linux__ */
+
+#endif /* FSM_LINUX_H_ */
+
+/***************************** END OF FILE ************************************/
@@ -0,0 +1,160 @@
+/**
+ ******************************************************************************
+ * @file           : fsm_record.h
+ * @author         : Mauricio Barroso Benavides
+ * @date           : Oct 18, 2026
+ * @brief          : This file contains all the definitios, data types and
+ *                   function prototypes for fsm_record.c file
+ ******************************************************************************
+ * @attention
+ *
+ * MIT License
+ *
+ * Copyright (c) 2026 Mauricio Barroso Benavides
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef FSM_RECORD_H_
+#define FSM_RECORD_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm.h"
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+  int *val;
+  fsm_input_t *input; /* Versioned input of val, NULL for a plain int */
+  int last;           /* Last recorded value, 0 before the first run */
+} fsm_recorder_input_t;
+
+typedef struct fsm_recorder {
+  struct {
+    fsm_recorder_input_t *inputs;
+    size_t len;
+  } inputs_list;
+
+  uint8_t *buf;    /* Append-only log */
+  size_t len;      /* Bytes used */
+  size_t size;     /* Bytes allocated */
+  size_t max_size; /* Maximum bytes of the log, 0 for no limit */
+  uint32_t last_ms;
+  uint32_t runs;  /* Runs recorded */
+  bool truncated; /* The log is full, the next runs are not recorded */
+} fsm_recorder_t;
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+/**
+ * @brief Function to initialize an input recorder.
+ *
+ * A recorder attached with fsm_set_recorder() logs the time of each fsm_run()
+ * and the values of the event inputs that changed since the previous run. Each
+ * run is a varint time delta followed by the changed inputs as varint index
+ * and zigzag value delta, so a run without input changes takes 1 or 2 bytes.
+ *
+ * @param me       : Pointer to a fsm_recorder_t instance
+ * @param max_size : Maximum bytes of the log, 0 for no limit
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_recorder_init(fsm_recorder_t *const me, size_t max_size);
+
+/**
+ * @brief Function to deinitialize an input recorder. The log is freed.
+ *
+ * @param me : Pointer to a fsm_recorder_t instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_recorder_deinit(fsm_recorder_t *const me);
+
+/**
+ * @brief Function to add an input to the inputs watched by a recorder. It is
+ *        called by fsm_set_recorder() for each event of the FSM instance.
+ *
+ * @param me    : Pointer to a fsm_recorder_t instance
+ * @param val   : Pointer to the input value
+ * @param input : Pointer to the versioned input of val, NULL for a plain int
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: out of memory
+ */
+fsm_err_t fsm_recorder_watch(fsm_recorder_t *const me, int *val,
+                             fsm_input_t *input);
+
+/**
+ * @brief Function to record the inputs of a run. It is called by fsm_run()
+ *        of the attached FSM instance before the actions are executed.
+ *
+ * @param me     : Pointer to a fsm_recorder_t instance
+ * @param now_ms : Time of the run in ms
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: the log is full, the run is not recorded
+ */
+fsm_err_t fsm_recorder_sample(fsm_recorder_t *const me, uint32_t now_ms);
+
+/**
+ * @brief Function to replay a log into a FSM instance.
+ *
+ * The instance must have the same definition and initial state as the
+ * recorded one. For each recorded run the inputs are set to their recorded
+ * values and the instance is run with fsm_run_at() at the recorded time, as
+ * fast as possible.
+ *
+ * @param fsm  : Pointer to a fsm_t instance
+ * @param buf  : Pointer to the log
+ * @param len  : Bytes of the log
+ * @param runs : Pointer to store the number of runs replayed, can be NULL
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter or instance with a time source
+ *   - FSM_ERR_NO_MEM: out of memory
+ *   - FSM_ERR_FAIL: the log is corrupted or doesn't match the instance
+ */
+fsm_err_t fsm_replay(fsm_t *fsm, const uint8_t *buf, size_t len,
+                     size_t *runs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FSM_RECORD_H_ */
+
+/***************************** END OF FILE ************************************/
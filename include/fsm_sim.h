@@ -0,0 +1,165 @@
+/**
+ ******************************************************************************
+ * @file           : fsm_sim.h
+ * @author         : Mauricio Barroso Benavides
+ * @date           : Oct 18, 2026
+ * @brief          : This file contains all the definitios, data types and
+ *                   function prototypes for fsm_sim.c file
+ ******************************************************************************
+ * @attention
+ *
+ * MIT License
+ *
+ * Copyright (c) 2026 Mauricio Barroso Benavides
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef FSM_SIM_H_
+#define FSM_SIM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm.h"
+#include "fsm_wheel.h"
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+  uint32_t time_ms;
+  uint32_t seq; /* Insertion order of the events with the same time */
+  fsm_t *fsm;   /* Instance to run after the input is applied, can be NULL */
+  fsm_fn_t fn;  /* Function that applies the input */
+  void *arg;
+} fsm_sim_event_t;
+
+typedef struct {
+  fsm_wheel_t wheel; /* Timeouts of the instances */
+  struct {
+    fsm_sim_event_t *events; /* Binary min-heap ordered by time and seq */
+    size_t len;
+    size_t size;
+  } queue;
+  uint32_t seq;
+  uint32_t now_ms; /* Virtual time */
+} fsm_sim_t;
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+/**
+ * @brief Function to initialize a simulator.
+ *
+ * The simulator owns a virtual time that starts at 0 ms. Instead of running
+ * the instances on every tick, it jumps to the time of the next input event or
+ * the next timeout of an instance, so idle periods cost nothing. Events with
+ * the same time are applied in the order they were injected, so the results
+ * are reproducible.
+ *
+ * @param me      : Pointer to a fsm_sim_t instance
+ * @param len     : Number of slots of the timer wheel, must be a power of 2
+ * @param tick_ms : Time covered by each slot in ms
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: out of memory
+ */
+fsm_err_t fsm_sim_init(fsm_sim_t *const me, size_t len, uint32_t tick_ms);
+
+/**
+ * @brief Function to deinitialize a simulator. All the FSM instances are
+ *        removed and the pending input events are discarded.
+ *
+ * @param me : Pointer to a fsm_sim_t instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_sim_deinit(fsm_sim_t *const me);
+
+/**
+ * @brief Function to add a FSM instance to a simulator. The instance is run
+ *        at the current virtual time to execute its entry action. The get_ms
+ *        function of the instance is not used while it is simulated.
+ *
+ * @param me  : Pointer to a fsm_sim_t instance
+ * @param fsm : Pointer to a fsm_t instance without time source set with
+ *              fsm_set_time_source()
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_sim_add(fsm_sim_t *const me, fsm_t *fsm);
+
+/**
+ * @brief Function to inject an input event in a simulator.
+ *
+ * At time_ms the function fn is called with arg, e.g. to set a variable
+ * compared by the events of a transition, and then the instance fsm is run.
+ *
+ * @param me      : Pointer to a fsm_sim_t instance
+ * @param time_ms : Virtual time of the event in ms, not before the current
+ *                  virtual time
+ * @param fsm     : Pointer to a fsm_t instance to run, can be NULL
+ * @param fn      : Function that applies the input, can be NULL
+ * @param arg     : Function argument
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: out of memory
+ */
+fsm_err_t fsm_sim_inject(fsm_sim_t *const me, uint32_t time_ms, fsm_t *fsm,
+                         fsm_fn_t fn, void *arg);
+
+/**
+ * @brief Function to run a simulator until a virtual time.
+ *
+ * The input events and the timeouts up to end_ms, included, are processed in
+ * time order and then the virtual time is set to end_ms. An instance that
+ * changes its state on every run is run again without advancing the virtual
+ * time, so it must reach a state that waits for an input or a timeout.
+ *
+ * @param me     : Pointer to a fsm_sim_t instance
+ * @param end_ms : Virtual time to stop in ms
+ * @param runs   : Pointer to store the number of instances run, can be NULL
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_sim_run_until(fsm_sim_t *const me, uint32_t end_ms, size_t *runs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FSM_SIM_H_ */
+
+/***************************** END OF FILE ************************************/
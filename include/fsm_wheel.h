@@ -0,0 +1,186 @@
+/**
+ ******************************************************************************
+ * @file           : fsm_wheel.h
+ * @author         : Mauricio Barroso Benavides
+ * @date           : Oct 18, 2026
+ * @brief          : This file contains all the definitios, data types and
+ *                   function prototypes for fsm_wheel.c file
+ ******************************************************************************
+ * @attention
+ *
+ * MIT License
+ *
+ * Copyright (c) 2026 Mauricio Barroso Benavides
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef FSM_WHEEL_H_
+#define FSM_WHEEL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm.h"
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct fsm_wheel {
+  fsm_timer_t *slots; /* Sentinels of the circular lists of each slot */
+  size_t len;         /* Number of slots, power of 2 */
+  fsm_timer_t due;    /* Timers already expired when scheduled */
+  uint32_t tick_ms;
+  uint32_t now_ms; /* Time of the last advance */
+} fsm_wheel_t;
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+/**
+ * @brief Function to initialize a timer wheel.
+ *
+ * The wheel is a hashed timing wheel shared by many FSM instances. Each
+ * registered instance is armed with the earliest pending timeout of its
+ * current state and it is run only when that timeout expires, so the cost of
+ * fsm_wheel_advance() depends on the expired instances and not on the number
+ * of registered instances.
+ *
+ * @param me      : Pointer to a fsm_wheel_t instance
+ * @param len     : Number of slots, must be a power of 2
+ * @param tick_ms : Time covered by each slot in ms
+ * @param now_ms  : Current time in ms
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_NO_MEM: out of memory
+ */
+fsm_err_t fsm_wheel_init(fsm_wheel_t *const me, size_t len, uint32_t tick_ms,
+                         uint32_t now_ms);
+
+/**
+ * @brief Function to deinitialize a timer wheel. All the registered FSM
+ *        instances are removed.
+ *
+ * @param me : Pointer to a fsm_wheel_t instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_wheel_deinit(fsm_wheel_t *const me);
+
+/**
+ * @brief Function to register a FSM instance in a timer wheel. The instance is
+ *        run in the next advance to execute its entry action.
+ *
+ * @param me  : Pointer to a fsm_wheel_t instance
+ * @param fsm : Pointer to a fsm_t instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_wheel_add(fsm_wheel_t *const me, fsm_t *fsm);
+
+/**
+ * @brief Function to remove a FSM instance from a timer wheel.
+ *
+ * @param me  : Pointer to a fsm_wheel_t instance
+ * @param fsm : Pointer to a fsm_t instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_wheel_remove(fsm_wheel_t *const me, fsm_t *fsm);
+
+/**
+ * @brief Function to advance a timer wheel and run the FSM instances whose
+ *        timers expired. The instances are run at now_ms with fsm_run_at(),
+ *        the ones with a time source set with fsm_set_time_source() at its
+ *        current time with fsm_run_at_ticks(). now_ms must follow the same
+ *        clock.
+ *
+ * @param me      : Pointer to a fsm_wheel_t instance
+ * @param now_ms  : Current time in ms
+ * @param expired : Pointer to store the number of instances run, can be NULL
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_wheel_advance(fsm_wheel_t *const me, uint32_t now_ms,
+                            size_t *expired);
+
+/**
+ * @brief Function to get the earliest expiration time of the timers armed in
+ *        a timer wheel.
+ *
+ * @param me        : Pointer to a fsm_wheel_t instance
+ * @param expiry_ms : Pointer to store the absolute expiration time in ms
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ *   - FSM_ERR_FAIL: no timer armed
+ */
+fsm_err_t fsm_wheel_next_expiry(fsm_wheel_t *const me, uint32_t *expiry_ms);
+
+/**
+ * @brief Function to arm the timer of a FSM instance registered in a timer
+ *        wheel. It is called by fsm_run().
+ *
+ * @param me        : Pointer to a fsm_wheel_t instance
+ * @param fsm       : Pointer to a fsm_t instance
+ * @param expiry_ms : Absolute expiration time in ms
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_wheel_schedule(fsm_wheel_t *const me, fsm_t *fsm,
+                             uint32_t expiry_ms);
+
+/**
+ * @brief Function to disarm the timer of a FSM instance registered in a timer
+ *        wheel. It is called by fsm_run().
+ *
+ * @param me  : Pointer to a fsm_wheel_t instance
+ * @param fsm : Pointer to a fsm_t instance
+ *
+ * @return
+ *   - FSM_ERR_OK: succeed
+ *   - FSM_ERR_INVALID_PARAM: invalid parameter
+ */
+fsm_err_t fsm_wheel_cancel(fsm_wheel_t *const me, fsm_t *fsm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FSM_WHEEL_H_ */
+
+/***************************** END OF FILE ************************************/
@@ -0,0 +1,182 @@
+/**
+ ******************************************************************************
+ * @file           : bench_fsm.c
+ * @author         : Mauricio Barroso Benavides
+ * @date           : Oct 18, 2026
+ * @brief          : RAM and cache benchmark of the FSM layouts
+ ******************************************************************************
+ * @attention
+ *
+ * MIT License
+ *
+ * Copyright (c) 2026 Mauricio Barroso Benavides
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* Private macro -------------------------------------------------------------*/
+#define MACHINES 20000
+#define ROUNDS 200
+
+/* Private typedef -----------------------------------------------------------*/
+/* Button states, the same machine that the multi function button example */
+enum {
+	BUTTON_STATE_IDLE = 0,
+	BUTTON_STATE_DEBOUNCE,
+	BUTTON_STATE_PRESSED,
+	BUTTON_STATE_RELEASED,
+	BUTTON_STATE_SINGLE,
+	BUTTON_STATE_DOUBLE,
+	BUTTON_STATE_LONG
+};
+
+/* Private variables ---------------------------------------------------------*/
+static fsm_t machines[MACHINES];
+static int levels[MACHINES];
+static uint32_t now_ms;
+
+/* Private function prototypes -----------------------------------------------*/
+static bool eval_eq(int a, int b) { return a == b; }
+static uint32_t get_ms(void) { return now_ms; }
+
+static void build_button(fsm_t *fsm, int *level) {
+	fsm_trans_t *t;
+	fsm_init(fsm, BUTTON_STATE_IDLE, get_ms);
+	fsm_add_transition(fsm, &t, BUTTON_STATE_IDLE, BUTTON_STATE_DEBOUNCE);
+	fsm_add_event_cmp(fsm, t, level, 0, eval_eq);
+	fsm_add_transition(fsm, &t, BUTTON_STATE_DEBOUNCE, BUTTON_STATE_IDLE);
+	fsm_add_event_cmp(fsm, t, level, 1, eval_eq);
+	fsm_add_event_timeout(fsm, t, 40);
+	fsm_add_transition(fsm, &t, BUTTON_STATE_DEBOUNCE, BUTTON_STATE_PRESSED);
+	fsm_add_event_cmp(fsm, t, level, 0, eval_eq);
+	fsm_add_event_timeout(fsm, t, 40);
+	fsm_add_transition(fsm, &t, BUTTON_STATE_PRESSED, BUTTON_STATE_RELEASED);
+	fsm_add_event_cmp(fsm, t, level, 1, eval_eq);
+	fsm_add_transition(fsm, &t, BUTTON_STATE_RELEASED, BUTTON_STATE_SINGLE);
+	fsm_add_event_timeout(fsm, t, 100);
+	fsm_add_transition(fsm, &t, BUTTON_STATE_RELEASED, BUTTON_STATE_DOUBLE);
+	fsm_add_event_cmp(fsm, t, level, 0, eval_eq);
+	fsm_add_transition(fsm, &t, BUTTON_STATE_SINGLE, BUTTON_STATE_IDLE);
+	fsm_add_transition(fsm, &t, BUTTON_STATE_DOUBLE, BUTTON_STATE_IDLE);
+	fsm_add_event_cmp(fsm, t, level, 1, eval_eq);
+	fsm_add_transition(fsm, &t, BUTTON_STATE_PRESSED, BUTTON_STATE_LONG);
+	fsm_add_event_timeout(fsm, t, 3000);
+	fsm_add_transition(fsm, &t, BUTTON_STATE_LONG, BUTTON_STATE_IDLE);
+	fsm_add_event_cmp(fsm, t, level, 1, eval_eq);
+}
+
+static size_t machine_bytes(fsm_t *fsm) {
+	/* Same accounting as the library, with the allocated capacities */
+	fsm_memory_usage_t usage;
+	fsm_memory_usage(fsm, &usage);
+	return sizeof *fsm + usage.total;
+}
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static int open_cache_misses(void) {
+#if defined(__linux__)
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof attr);
+	attr.size = sizeof attr;
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	return -1;
+#endif
+}
+
+/* Main ----------------------------------------------------------------------*/
+int main(void) {
+	for (size_t i = 0; i < MACHINES; i++) {
+		levels[i] = 1;
+		build_button(&machines[i], &levels[i]);
+	}
+
+	int fd = open_cache_misses();
+#if defined(__linux__)
+	if (fd >= 0) {
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+
+	/* Press and release the buttons at different phases */
+	uint64_t start = now_ns();
+	for (uint32_t r = 0; r < ROUNDS; r++) {
+		now_ms = r * 10;
+		for (size_t i = 0; i < MACHINES; i++) {
+			levels[i] = ((r + i) % 50) < 20 ? 0 : 1;
+			fsm_run(&machines[i]);
+		}
+	}
+	uint64_t elapsed = now_ns() - start;
+
+	long long misses = -1;
+#if defined(__linux__)
+	if (fd >= 0) {
+		ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(fd, &misses, sizeof misses) != sizeof misses) {
+			misses = -1;
+		}
+		close(fd);
+	}
+#endif
+
+	printf("%s layout\n", FSM_PACKED_LAYOUT ? "Packed" : "Default");
+	printf("  sizeof(fsm_trans_t)  : %zu bytes\n", sizeof(fsm_trans_t));
+	printf("  sizeof(fsm_event_t)  : %zu bytes\n", sizeof(fsm_event_t));
+	printf("  RAM per machine      : %zu bytes\n", machine_bytes(&machines[0]));
+	printf("  fsm_run()            : %.1f ns\n",
+		(double)elapsed / ((double)ROUNDS * MACHINES));
+	if (misses >= 0) {
+		printf("  cache misses per run : %.3f\n",
+			(double)misses / ((double)ROUNDS * MACHINES));
+	} else {
+		printf("  cache misses per run : n/a (perf events unavailable)\n");
+	}
+
+	return 0;
+}
+
+/***************************** END OF FILE ************************************/
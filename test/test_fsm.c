@@ -34,8 +34,25 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "fsm.h"
+#include "fsm_dispatch.h"
+#include "fsm_fleet.h"
+#include "fsm_linux.h"
+#include "fsm_bus.h"
+#include "fsm_record.h"
+#include "fsm_sim.h"
+#include "fsm_wheel.h"
 #include "unity.h"
 
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
 /* Private typedef -----------------------------------------------------------*/
 /* State definitions */
 enum { STATE_S0 = 0, STATE_S1, STATE_S2 };
@@ -53,9 +70,16 @@ static int enter_s0_cnt, update_s0_cnt, exit_s0_cnt;
 static int enter_s1_cnt, exit_s1_cnt;
 static int enter_s2_cnt;
 
+/* Counter for evaluation tests */
+static int eval_cnt;
+
 /* Private function prototypes -----------------------------------------------*/
 static bool eval_eq(int a, int b) { return a == b; }
+static bool eval_eq_cnt(int a, int b) { eval_cnt++; return a == b; }
+static bool eval_gt_cnt(int a, int b) { eval_cnt++; return a > b; }
 static uint32_t get_fake_time(void) { return fake_time; }
+static uint64_t fake_time_us;
+static uint64_t get_fake_time_us(void) { return fake_time_us; }
 
 // --- Callback stubs for timeout tests ---
 static void cb_enter_s0(void *arg) { enter_s0_cnt++; }
@@ -64,6 +88,12 @@ static void cb_exit_s0(void *arg) { exit_s0_cnt++; }
 static void cb_enter_s1(void *arg) { enter_s1_cnt++; }
 static void cb_exit_s1(void *arg) { exit_s1_cnt++; }
 static void cb_enter_s2(void *arg) { enter_s2_cnt++; }
+static void cb_count(void *arg) { (*(int *)arg)++; }
+
+/* Actions log for dispatch tests */
+static char log_buf[32];
+static size_t log_len;
+static void cb_log(void *arg) { log_buf[log_len++] = *(const char *)arg; }
 
 void setUp(void) {
 	/* Reset fake time */
@@ -76,6 +106,10 @@ void setUp(void) {
 	enter_s0_cnt = update_s0_cnt = exit_s0_cnt = 0;
 	enter_s1_cnt = exit_s1_cnt = 0;
 	enter_s2_cnt = 0;
+	/* Reset evaluation counter */
+	eval_cnt = 0;
+	/* Reset actions log */
+	log_len = 0;
 }
 
 void tearDown(void) {
@@ -277,6 +311,1520 @@ void test_timeout_without_time_fn_does_not_crash(void) {
 	TEST_ASSERT_EQUAL_INT(1, enter_s1_cnt);
 }
 
+void test_bitset_mode_evaluates_shared_predicates_once(void) {
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	int var = 0, other = 0;
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_register_state_actions(&fsm, STATE_S1, cb_enter_s1, NULL, NULL, NULL, NULL, NULL);
+	fsm_register_state_actions(&fsm, STATE_S2, cb_enter_s2, NULL, NULL, NULL, NULL, NULL);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_cmp(&fsm, trans, &var, 1, eval_eq_cnt);
+	fsm_add_event_cmp(&fsm, trans, &other, 1, eval_eq_cnt);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S2);
+	fsm_add_event_cmp(&fsm, trans, &var, 1, eval_eq_cnt);
+	fsm_add_event_cmp(&fsm, trans, &other, 2, eval_eq_cnt);
+
+	/* Default mode evaluates every event of every transition */
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(4, eval_cnt);
+
+	/* Bitset mode evaluates the shared var == 1 predicate only once */
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_set_eval_mode(&fsm, FSM_EVAL_MODE_BITSET));
+	TEST_ASSERT_EQUAL_INT(3, fsm.preds_list.len);
+	eval_cnt = 0;
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(3, eval_cnt);
+
+	/* Both AND transitions are resolved from the bitset */
+	var = 1;
+	other = 2;
+	fsm_run(&fsm);
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(0, enter_s1_cnt);
+	TEST_ASSERT_EQUAL_INT(1, enter_s2_cnt);
+}
+
+void test_bitset_mode_is_built_at_run_and_falls_back(void) {
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	fsm_eval_mode_t mode;
+	int vals[FSM_PREDS_MAX + 1] = {0};
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_set_eval_mode(&fsm, FSM_EVAL_MODE_BITSET));
+
+	/* The table is built by the run, not by each added event */
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_cmp(&fsm, trans, &vals[0], 1, eval_eq);
+	TEST_ASSERT_NULL(fsm.preds_list.preds);
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(1, fsm.preds_list.len);
+
+	/* Too many predicates, the run falls back to the default mode */
+	fsm_set_event_op(&fsm, trans, FSM_OP_OR);
+	for (int i = 1; i <= FSM_PREDS_MAX; i++) {
+		fsm_add_event_cmp(&fsm, trans, &vals[i], 1, eval_eq);
+	}
+	vals[FSM_PREDS_MAX] = 1;
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_get_eval_mode(&fsm, &mode));
+	TEST_ASSERT_EQUAL_INT(FSM_EVAL_MODE_DEFAULT, mode);
+	TEST_ASSERT_EQUAL_UINT8(STATE_S1, fsm.current_state);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_FAIL, fsm_set_eval_mode(&fsm, FSM_EVAL_MODE_BITSET));
+
+	fsm_deinit(&fsm);
+}
+
+void test_input_events_are_cached_until_version_changes(void) {
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	fsm_input_t in;
+	fsm_memo_stats_t stats;
+	fsm_input_init(&in, 0);
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_register_state_actions(&fsm, STATE_S1, cb_enter_s1, NULL, NULL, NULL, NULL, NULL);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_set_event_op(&fsm, trans, FSM_OP_OR);
+	fsm_add_event_input(&fsm, trans, &in, 1, eval_eq_cnt);
+	fsm_add_event_timeout(&fsm, trans, 100);
+
+	/* Only the first run evaluates the input event */
+	for (int i = 0; i < 5; i++) {
+		fake_time = i * 10;
+		fsm_run(&fsm);
+	}
+	TEST_ASSERT_EQUAL_INT(1, eval_cnt);
+	fsm_get_memo_stats(&fsm, &stats);
+	TEST_ASSERT_EQUAL_INT(4, stats.hits);
+	TEST_ASSERT_EQUAL_INT(1, stats.misses);
+
+	/* Setting the same value keeps the cached result */
+	fsm_input_set(&in, 0);
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(1, eval_cnt);
+
+	/* A new value is evaluated again */
+	fsm_input_set(&in, 1);
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(2, eval_cnt);
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(1, enter_s1_cnt);
+}
+
+void test_cached_input_events_are_evaluated_again_on_entry(void) {
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	fsm_input_t in;
+	int other = 0;
+	fsm_input_init(&in, 0);
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_register_state_actions(&fsm, STATE_S1, cb_enter_s1, NULL, NULL, NULL, NULL, NULL);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_input(&fsm, trans, &in, 1, eval_eq);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S2);
+	fsm_add_event_cmp(&fsm, trans, &other, 1, eval_eq);
+	fsm_add_transition(&fsm, &trans, STATE_S2, STATE_S0);
+	fsm_add_event_cmp(&fsm, trans, &other, 0, eval_eq);
+
+	/* Cache the result of the input and leave the state */
+	fsm_run(&fsm);
+	other = 1;
+	fsm_run(&fsm);
+
+	/* The version changes 65536 times while away */
+	for (int i = 1; i < 65536; i++) {
+		fsm_input_set(&in, i);
+	}
+	fsm_input_set(&in, 1);
+
+	other = 0;
+	fsm_run(&fsm);
+	fsm_run(&fsm);
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(1, enter_s1_cnt);
+}
+
+void test_cached_input_events_still_check_timeout(void) {
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	fsm_input_t in;
+	fsm_input_init(&in, 0);
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_register_state_actions(&fsm, STATE_S1, cb_enter_s1, NULL, NULL, NULL, NULL, NULL);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_set_event_op(&fsm, trans, FSM_OP_OR);
+	fsm_add_event_input(&fsm, trans, &in, 1, eval_eq_cnt);
+	fsm_add_event_timeout(&fsm, trans, 50);
+
+	fsm_run(&fsm);
+	fake_time = 50;
+	fsm_run(&fsm);
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(1, eval_cnt);
+	TEST_ASSERT_EQUAL_INT(1, enter_s1_cnt);
+}
+
+void test_guard_expression_with_short_circuit(void) {
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	int a = 0, b = 0;
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_register_state_actions(&fsm, STATE_S0, NULL, NULL, NULL, NULL, cb_exit_s0, NULL);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+
+	/* (a == 1 && b > 3) || timeout */
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_set_guard(&fsm, trans,
+		FSM_EXPR_OR(FSM_EXPR_AND(FSM_EXPR_CMP(&a, 1, eval_eq_cnt),
+								 FSM_EXPR_CMP(&b, 3, eval_gt_cnt)),
+					FSM_EXPR_TIMEOUT(100))));
+
+	/* a != 1 skips the b comparison */
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(1, eval_cnt);
+	TEST_ASSERT_EQUAL_INT(0, exit_s0_cnt);
+
+	/* a == 1 but b <= 3 */
+	a = 1;
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(3, eval_cnt);
+	TEST_ASSERT_EQUAL_INT(0, exit_s0_cnt);
+
+	/* Timeout alone makes the transition */
+	a = 0;
+	fake_time = 100;
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(1, exit_s0_cnt);
+}
+
+void test_guard_expression_not_and_invalid(void) {
+	fsm_t fsm, other;
+	fsm_trans_t *trans = NULL, *foreign = NULL;
+	int a = 0;
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_register_state_actions(&fsm, STATE_S0, NULL, NULL, NULL, NULL, cb_exit_s0, NULL);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_init(&other, STATE_S0, get_fake_time);
+	fsm_add_transition(&other, &foreign, STATE_S0, STATE_S1);
+
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_INVALID_PARAM, fsm_set_guard(&fsm, trans,
+		FSM_EXPR_NOT(NULL)));
+	/* A transition of another instance is rejected */
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_INVALID_PARAM, fsm_set_guard(&fsm, foreign,
+		FSM_EXPR_TIMEOUT(50)));
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_INVALID_PARAM, fsm_register_trans_action(&fsm,
+		foreign, cb_exit_s0, NULL));
+	fsm_deinit(&other);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_set_guard(&fsm, trans,
+		FSM_EXPR_AND(FSM_EXPR_NOT(FSM_EXPR_CMP(&a, 1, eval_eq)),
+					 FSM_EXPR_NOT(FSM_EXPR_TIMEOUT(50)))));
+
+	/* a != 1 before the timeout */
+	a = 1;
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(0, exit_s0_cnt);
+	a = 0;
+	fake_time = 60;
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(0, exit_s0_cnt);
+
+	/* Without guard the transition is unconditional */
+	fsm_set_guard(&fsm, trans, NULL);
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(1, exit_s0_cnt);
+}
+
+void test_wheel_runs_only_expired_instances(void) {
+	fsm_wheel_t wheel;
+	fsm_t fsm[3];
+	fsm_trans_t *trans = NULL;
+	int runs[3] = {0}, exits[3] = {0};
+	uint32_t timeouts[3] = {50, 100, 0};
+	size_t expired = 0;
+
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_wheel_init(&wheel, 16, 10, 0));
+	for (int i = 0; i < 3; i++) {
+		fsm_init(&fsm[i], STATE_S0, get_fake_time);
+		fsm_register_state_actions(&fsm[i], STATE_S0, cb_count, &runs[i], cb_count,
+			&runs[i], cb_count, &exits[i]);
+		fsm_add_transition(&fsm[i], &trans, STATE_S0, STATE_S1);
+		if (timeouts[i]) {
+			fsm_add_event_timeout(&fsm[i], trans, timeouts[i]);
+		} else {
+			fsm_add_event_cmp(&fsm[i], trans, &runs[i], -1, eval_eq);
+		}
+		fsm_wheel_add(&wheel, &fsm[i]);
+	}
+
+	/* All the instances execute their entry action */
+	fsm_wheel_advance(&wheel, 0, &expired);
+	TEST_ASSERT_EQUAL_INT(3, expired);
+
+	/* Nothing expires before 50 ms */
+	for (fake_time = 10; fake_time < 50; fake_time += 10) {
+		fsm_wheel_advance(&wheel, fake_time, &expired);
+		TEST_ASSERT_EQUAL_INT(0, expired);
+	}
+
+	/* Only the first instance is run on its timeout */
+	fake_time = 50;
+	fsm_wheel_advance(&wheel, fake_time, &expired);
+	TEST_ASSERT_EQUAL_INT(1, expired);
+	TEST_ASSERT_EQUAL_INT(1, exits[0]);
+	TEST_ASSERT_EQUAL_INT(0, exits[1]);
+
+	/* The first instance is run again to enter its new state */
+	fake_time = 60;
+	fsm_wheel_advance(&wheel, fake_time, &expired);
+	TEST_ASSERT_EQUAL_INT(1, expired);
+
+	/* The second instance after a jump over several ticks */
+	fake_time = 130;
+	fsm_wheel_advance(&wheel, fake_time, &expired);
+	TEST_ASSERT_EQUAL_INT(1, expired);
+	TEST_ASSERT_EQUAL_INT(1, exits[1]);
+	TEST_ASSERT_EQUAL_INT(1, runs[2]);
+	TEST_ASSERT_EQUAL_INT(0, exits[2]);
+
+	fsm_wheel_deinit(&wheel);
+}
+
+static fsm_sim_t *sim_ptr;
+static uint32_t sim_press_ms;
+static void cb_press(void *arg) { *(int *)arg = 1; }
+static void cb_release(void *arg) { *(int *)arg = 0; }
+static void cb_stamp_press(void *arg) { sim_press_ms = sim_ptr->now_ms; }
+
+void test_wheel_runs_time64_instances_in_ticks(void) {
+	fsm_wheel_t wheel;
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+
+	/* The ms time wraps around during the timeout */
+	fake_time_us = (uint64_t)UINT32_MAX * 1000;
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_wheel_init(&wheel, 16, 1, UINT32_MAX));
+	fsm_init(&fsm, STATE_S0, NULL);
+	fsm_set_time_source(&fsm, get_fake_time_us, 1000);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_timeout(&fsm, trans, 5);
+	fsm_wheel_add(&wheel, &fsm);
+	fsm_wheel_advance(&wheel, UINT32_MAX, NULL);
+
+	/* An early run after the wrap doesn't expire the timeout */
+	fake_time_us += 2000;
+	fsm_wheel_schedule(&wheel, &fsm, 1);
+	fsm_wheel_advance(&wheel, 1, NULL);
+	TEST_ASSERT_EQUAL_INT(STATE_S0, fsm.current_state);
+
+	fake_time_us += 3000;
+	fsm_wheel_advance(&wheel, 4, NULL);
+	TEST_ASSERT_EQUAL_INT(STATE_S1, fsm.current_state);
+
+	fsm_wheel_remove(&wheel, &fsm);
+	fsm_wheel_deinit(&wheel);
+}
+
+void test_sim_fast_forwards_to_inputs_and_timeouts(void) {
+	fsm_sim_t sim;
+	fsm_t blink, button;
+	fsm_trans_t *trans = NULL;
+	int toggles = 0, pressed = 0;
+	size_t runs = 0;
+	sim_ptr = &sim;
+
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_sim_init(&sim, 64, 1));
+
+	/* The virtual time can't drive a 64-bit time source */
+	fsm_init(&blink, STATE_S0, NULL);
+	fsm_set_time_source(&blink, get_fake_time_us, 1000);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_INVALID_PARAM, fsm_sim_add(&sim, &blink));
+
+	/* Toggles every 100 ms */
+	fsm_init(&blink, STATE_S0, get_fake_time);
+	fsm_register_state_actions(&blink, STATE_S0, NULL, NULL, NULL, NULL,
+		cb_count, &toggles);
+	fsm_add_transition(&blink, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_timeout(&blink, trans, 100);
+	fsm_add_transition(&blink, &trans, STATE_S1, STATE_S0);
+	fsm_add_event_timeout(&blink, trans, 100);
+	fsm_sim_add(&sim, &blink);
+
+	/* Pressed while the input is 1, released after 50 ms */
+	fsm_init(&button, STATE_S0, get_fake_time);
+	fsm_register_state_actions(&button, STATE_S1, cb_stamp_press, NULL, NULL,
+		NULL, NULL, NULL);
+	fsm_add_transition(&button, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_cmp(&button, trans, &pressed, 1, eval_eq);
+	fsm_add_transition(&button, &trans, STATE_S1, STATE_S0);
+	fsm_add_event_cmp(&button, trans, &pressed, 0, eval_eq);
+	fsm_add_event_timeout(&button, trans, 50);
+	fsm_sim_add(&sim, &button);
+
+	fsm_sim_inject(&sim, 1800000, &button, cb_press, &pressed);
+	fsm_sim_inject(&sim, 1800010, &button, cb_release, &pressed);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_sim_run_until(&sim, 3600000, &runs));
+
+	/* One hour of blinking, the entry actions are run at the same instant */
+	TEST_ASSERT_EQUAL_UINT32(3600000, sim.now_ms);
+	TEST_ASSERT_EQUAL_INT(18000, toggles);
+	TEST_ASSERT_EQUAL_UINT32(1800000, sim_press_ms);
+	TEST_ASSERT_EQUAL_INT(STATE_S0, button.current_state);
+	TEST_ASSERT_LESS_THAN(80000, runs);
+
+	/* Events can't be injected in the past */
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_INVALID_PARAM,
+		fsm_sim_inject(&sim, 100, &button, NULL, NULL));
+	fsm_sim_deinit(&sim);
+}
+
+static void cb_observe(fsm_t *fsm, uint8_t from_state, uint8_t to_state,
+	void *arg) {
+	log_buf[log_len++] = *(const char *)arg;
+	log_buf[log_len++] = (char)('0' + from_state);
+	log_buf[log_len++] = (char)('0' + to_state);
+}
+
+void test_observers_are_notified_by_state(void) {
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	fsm_observer_t all, from_s0, to_s2;
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_transition(&fsm, &trans, STATE_S1, STATE_S2);
+	fsm_add_transition(&fsm, &trans, STATE_S2, STATE_S0);
+
+	fsm_subscribe(&fsm, &all, FSM_STATE_ANY, FSM_STATE_ANY, cb_observe, "a");
+	fsm_subscribe(&fsm, &from_s0, STATE_S0, FSM_STATE_ANY, cb_observe, "f");
+	fsm_subscribe(&fsm, &to_s2, FSM_STATE_ANY, STATE_S2, cb_observe, "t");
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_INVALID_PARAM,
+		fsm_subscribe(&fsm, &all, 256, FSM_STATE_ANY, cb_observe, "x"));
+
+	/* S0 -> S1 -> S2 -> S0 */
+	for (int i = 0; i < 3; i++) {
+		fsm_run(&fsm);
+	}
+	TEST_ASSERT_EQUAL_INT(15, log_len);
+	TEST_ASSERT_EQUAL_MEMORY("a01f01a12t12a20", log_buf, log_len);
+
+	/* Only the observer of any state is left */
+	log_len = 0;
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_unsubscribe(&fsm, &from_s0));
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_unsubscribe(&fsm, &to_s2));
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_INVALID_PARAM, fsm_unsubscribe(&fsm, &to_s2));
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_MEMORY("a01", log_buf, 3);
+	TEST_ASSERT_EQUAL_INT(3, log_len);
+	fsm_unsubscribe(&fsm, &all);
+	TEST_ASSERT_NULL(fsm.observers.table);
+}
+
+static fsm_violation_t last_violation;
+static void cb_slow(void *arg) { fake_time += *(uint32_t *)arg; }
+static void cb_violation(fsm_t *fsm, const fsm_violation_t *violation,
+	void *arg) {
+	last_violation = *violation;
+	(*(int *)arg)++;
+}
+
+void test_budgets_report_dwell_and_action_violations(void) {
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	fsm_budget_stats_t stats;
+	uint32_t slow = 5;
+	int var = 0, violations = 0;
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_register_state_actions(&fsm, STATE_S1, cb_slow, &slow, NULL, NULL,
+		NULL, NULL);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_cmp(&fsm, trans, &var, 1, eval_eq);
+	fsm_set_state_budget(&fsm, STATE_S0, 60, 0);
+	fsm_set_state_budget(&fsm, STATE_S1, 0, 3);
+	fsm_set_budget_handler(&fsm, cb_violation, &violations, NULL);
+
+	/* S0 must be left within 60 ms, reported once per visit */
+	fsm_run(&fsm);
+	fake_time = 60;
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(0, violations);
+	fake_time = 70;
+	fsm_run(&fsm);
+	fake_time = 80;
+	var = 1;
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(1, violations);
+	TEST_ASSERT_EQUAL_INT(FSM_VIOLATION_DWELL, last_violation.type);
+	TEST_ASSERT_EQUAL_INT(STATE_S0, last_violation.state);
+	TEST_ASSERT_EQUAL_UINT32(70, last_violation.measured);
+	TEST_ASSERT_EQUAL_UINT32(0, last_violation.start);
+
+	/* The entry action of S1 takes 5 ms with a budget of 3 */
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(2, violations);
+	TEST_ASSERT_EQUAL_INT(FSM_VIOLATION_ACTION, last_violation.type);
+	TEST_ASSERT_EQUAL_INT(FSM_ACTION_TYPE_ENTRY, last_violation.action);
+	TEST_ASSERT_EQUAL_UINT32(5, last_violation.measured);
+	TEST_ASSERT_EQUAL_UINT32(80, last_violation.start);
+
+	fsm_get_budget_stats(&fsm, &stats);
+	TEST_ASSERT_EQUAL_UINT32(1, stats.dwell);
+	TEST_ASSERT_EQUAL_UINT32(1, stats.action);
+}
+
+void test_time64_timeouts_are_anchored_without_drift(void) {
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	fake_time_us = (uint64_t)1 << 40;
+	fsm_init(&fsm, STATE_S0, NULL);
+	TEST_ASSERT_EQUAL(FSM_ERR_OK, fsm_set_time_source(&fsm, get_fake_time_us,
+		1000));
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_timeout_ticks(&fsm, trans, 1500);
+	fsm_add_transition(&fsm, &trans, STATE_S1, STATE_S2);
+	fsm_add_event_timeout(&fsm, trans, 2);
+	fsm_add_transition(&fsm, &trans, STATE_S2, STATE_S0);
+	fsm_add_event_timeout(&fsm, trans, 2);
+	TEST_ASSERT_EQUAL(FSM_ERR_FAIL, fsm_set_time_source(&fsm,
+		get_fake_time_us, 1));
+
+	/* Sub-ms timeout */
+	uint64_t start = fake_time_us;
+	fsm_run(&fsm);
+	fake_time_us = start + 1499;
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(STATE_S0, fsm.current_state);
+	fake_time_us = start + 1500;
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(STATE_S1, fsm.current_state);
+
+	/* A late run catches up, each state entered when the previous timeout
+	expired: S1 at 1.5 ms, S2 at 3.5 ms and S0 at 5.5 ms */
+	fake_time_us = start + 6000;
+	fsm_run(&fsm);
+	fsm_run(&fsm);
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(STATE_S0, fsm.current_state);
+	fake_time_us = start + 6999;
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(STATE_S0, fsm.current_state);
+	fake_time_us = start + 7000;
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(STATE_S1, fsm.current_state);
+}
+
+void test_deinit_frees_memory_counted_by_usage(void) {
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	fsm_memory_usage_t usage;
+	int var = 0;
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	for (int i = 0; i < 3; i++) {
+		fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+		fsm_add_event_cmp(&fsm, trans, &var, i, eval_eq);
+	}
+	fsm_register_state_actions(&fsm, STATE_S2, cb_enter_s2, NULL, NULL, NULL,
+		NULL, NULL);
+
+	/* The tables grow in powers of 2 */
+	TEST_ASSERT_EQUAL(FSM_ERR_OK, fsm_memory_usage(&fsm, &usage));
+	TEST_ASSERT_EQUAL_UINT(4 * sizeof(fsm_trans_t), usage.trans);
+#if FSM_PACKED_LAYOUT
+	TEST_ASSERT_EQUAL_UINT(4 * sizeof(fsm_event_t), usage.events);
+#else
+	TEST_ASSERT_EQUAL_UINT(3 * sizeof(fsm_event_t), usage.events);
+#endif
+	TEST_ASSERT_EQUAL_UINT(4 * sizeof(fsm_action_t[3]), usage.actions);
+	TEST_ASSERT_EQUAL_UINT(usage.trans + usage.events + usage.actions +
+		usage.guards + usage.other, usage.total);
+
+	TEST_ASSERT_EQUAL(FSM_ERR_OK, fsm_deinit(&fsm));
+	fsm_memory_usage(&fsm, &usage);
+	TEST_ASSERT_EQUAL_UINT(0, usage.total);
+}
+
+/* Per instance counters of the context test */
+typedef struct {
+	int evals;
+	int actions;
+} ctx_counter_t;
+
+static bool eval_ctx_eq(void *ctx, int a, int b) {
+	((ctx_counter_t *)ctx)->evals++;
+	return a == b;
+}
+
+static void cb_ctx_count(void *ctx, void *arg) {
+	((ctx_counter_t *)ctx)->actions += *(int *)arg;
+}
+
+void test_context_is_passed_to_shared_callbacks(void) {
+	fsm_t fsms[2];
+	ctx_counter_t counters[2] = {{0}};
+	fsm_trans_t *trans = NULL;
+	int var = 0, one = 1, ten = 10;
+	void *ctx = NULL;
+
+	/* Same definition and callbacks, one context per instance */
+	for (int i = 0; i < 2; i++) {
+		fsm_init(&fsms[i], STATE_S0, get_fake_time);
+		TEST_ASSERT_EQUAL(FSM_ERR_OK, fsm_set_context(&fsms[i], &counters[i]));
+		fsm_register_state_actions_ctx(&fsms[i], STATE_S1, cb_ctx_count, &one,
+			NULL, NULL, NULL, NULL);
+		fsm_add_transition(&fsms[i], &trans, STATE_S0, STATE_S1);
+		fsm_add_event_cmp_ctx(&fsms[i], trans, &var, 1, eval_ctx_eq);
+		fsm_register_trans_action_ctx(&fsms[i], trans, cb_ctx_count, &ten);
+		fsm_add_transition(&fsms[i], &trans, STATE_S1, STATE_S0);
+		fsm_set_guard(&fsms[i], trans, FSM_EXPR_CMP_CTX(&var, 0, eval_ctx_eq));
+	}
+
+	fsm_get_context(&fsms[1], &ctx);
+	TEST_ASSERT_EQUAL_PTR(&counters[1], ctx);
+
+	fsm_run(&fsms[0]);
+	var = 1;
+	fsm_run(&fsms[0]);
+	fsm_run(&fsms[0]);
+	TEST_ASSERT_EQUAL_INT(STATE_S1, fsms[0].current_state);
+	TEST_ASSERT_EQUAL_INT(3, counters[0].evals);
+	TEST_ASSERT_EQUAL_INT(11, counters[0].actions);
+
+	fsm_run(&fsms[1]);
+	TEST_ASSERT_EQUAL_INT(1, counters[1].evals);
+	TEST_ASSERT_EQUAL_INT(10, counters[1].actions);
+	TEST_ASSERT_EQUAL_INT(11, counters[0].actions);
+}
+
+static bool eval_ctx_ge(void *ctx, int a, int b) { return a >= *(int *)ctx; }
+
+void test_context_change_discards_cached_results(void) {
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	fsm_input_t in;
+	int high = 10, low = 3;
+
+	fsm_input_init(&in, 5);
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_set_context(&fsm, &high);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_input_ctx(&fsm, trans, &in, 0, eval_ctx_ge);
+
+	fsm_run(&fsm);
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(STATE_S0, fsm.current_state);
+
+	/* The input didn't change but the threshold in the context did */
+	fsm_set_context(&fsm, &low);
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(STATE_S1, fsm.current_state);
+}
+
+void test_context_events_read_data_behind_context(void) {
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	fsm_input_t in;
+	int threshold = 10;
+	fsm_memo_stats_t stats;
+
+	fsm_input_init(&in, 5);
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_set_context(&fsm, &threshold);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_input_ctx(&fsm, trans, &in, 0, eval_ctx_ge);
+
+	fsm_run(&fsm);
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(STATE_S0, fsm.current_state);
+
+	/* Neither the input nor the context pointer changed, only the data */
+	threshold = 3;
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(STATE_S1, fsm.current_state);
+	fsm_get_memo_stats(&fsm, &stats);
+	TEST_ASSERT_EQUAL_UINT32(0, stats.hits);
+
+	fsm_deinit(&fsm);
+}
+
+/* Fleet test, the instances in S1 are sent back to S0 */
+static void cb_reset(fsm_t *fsm, void *arg) {
+	int *var;
+	fsm_get_context(fsm, (void **)&var);
+	*var = 0;
+	fsm_run(fsm);
+	(*(int *)arg)++;
+}
+
+void test_fleet_tracks_instances_by_state(void) {
+	fsm_fleet_t fleet;
+	fsm_t fsms[4];
+	fsm_trans_t *trans = NULL;
+	int vars[4] = {0}, visited = 0;
+	size_t count = 0;
+
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_fleet_init(&fleet, 2));
+	for (int i = 0; i < 4; i++) {
+		fsm_init(&fsms[i], STATE_S0, get_fake_time);
+		fsm_set_context(&fsms[i], &vars[i]);
+		fsm_add_transition(&fsms[i], &trans, STATE_S0, STATE_S1);
+		fsm_add_event_cmp(&fsms[i], trans, &vars[i], 1, eval_eq);
+		fsm_add_transition(&fsms[i], &trans, STATE_S1, STATE_S0);
+		fsm_add_event_cmp(&fsms[i], trans, &vars[i], 0, eval_eq);
+		fsm_fleet_add(&fleet, &fsms[i]);
+	}
+
+	fsm_fleet_count(&fleet, STATE_S0, &count);
+	TEST_ASSERT_EQUAL_INT(4, count);
+
+	/* Three instances move to S1 */
+	vars[0] = vars[1] = vars[3] = 1;
+	for (int i = 0; i < 4; i++) {
+		fsm_run(&fsms[i]);
+	}
+
+	fsm_fleet_count(&fleet, STATE_S0, &count);
+	TEST_ASSERT_EQUAL_INT(1, count);
+	fsm_fleet_count(&fleet, STATE_S1, &count);
+	TEST_ASSERT_EQUAL_INT(3, count);
+
+	/* Only the instances in S1 are visited, also when they leave it */
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK,
+		fsm_fleet_foreach(&fleet, STATE_S1, cb_reset, &visited));
+	TEST_ASSERT_EQUAL_INT(3, visited);
+	fsm_fleet_count(&fleet, STATE_S1, &count);
+	TEST_ASSERT_EQUAL_INT(0, count);
+
+	/* A removed instance is no longer counted */
+	fsm_deinit(&fsms[2]);
+	fsm_fleet_count(&fleet, STATE_S0, &count);
+	TEST_ASSERT_EQUAL_INT(3, count);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_INVALID_PARAM,
+		fsm_fleet_count(&fleet, STATE_S2, &count));
+
+	fsm_fleet_deinit(&fleet);
+	TEST_ASSERT_NULL(fsms[0].fleet);
+}
+
+/* Definition of the table test, it stays in rodata */
+static int table_var, table_trans_cnt, table_entry_cnt;
+
+static const fsm_table_event_t table_events[] = {
+	{&table_var, 1, eval_eq},
+	{&table_var, 0, eval_eq},
+};
+
+static const fsm_action_t table_states[][3] = {
+	[STATE_S1] = {{.fn = cb_count, .arg = &table_entry_cnt}},
+};
+
+static const fsm_table_row_t table_rows[] = {
+	{.from_state = STATE_S0, .next_state = STATE_S1, .op = FSM_OP_AND,
+	 .events = 0, .events_len = 1, .fn = cb_count, .arg = &table_trans_cnt},
+	{.from_state = STATE_S1, .next_state = STATE_S2, .op = FSM_OP_OR,
+	 .timeout = 100},
+	{.from_state = STATE_S2, .next_state = STATE_S0, .op = FSM_OP_AND,
+	 .timeout = 50, .events = 1, .events_len = 1},
+};
+
+static const fsm_table_t table = {
+	.rows = table_rows,
+	.rows_len = sizeof table_rows / sizeof table_rows[0],
+	.events = table_events,
+	.events_len = sizeof table_events / sizeof table_events[0],
+	.states = table_states,
+	.states_len = sizeof table_states / sizeof table_states[0],
+};
+
+void test_load_table_by_copy_and_by_reference(void) {
+	fsm_t copy, ref;
+	fsm_trans_t *trans = NULL;
+	fsm_memory_usage_t usage;
+	static const uint8_t expected[] = {STATE_S0, STATE_S1, STATE_S1, STATE_S2,
+		STATE_S2, STATE_S0};
+
+	fake_time = 0;
+	table_var = 0;
+	table_trans_cnt = table_entry_cnt = 0;
+	fsm_init(&copy, STATE_S0, get_fake_time);
+	fsm_init(&ref, STATE_S0, get_fake_time);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_load(&copy, &table, FSM_LOAD_COPY));
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_load(&ref, &table, FSM_LOAD_REF));
+
+	/* Both instances follow the same transitions */
+	for (size_t i = 0; i < sizeof expected; i++) {
+		if (i == 1) {
+			table_var = 1;
+		} else if (i == 3) {
+			fake_time = 100;
+			table_var = 0;
+		} else if (i == 5) {
+			fake_time = 150;
+		}
+		fsm_run(&copy);
+		fsm_run(&ref);
+		TEST_ASSERT_EQUAL_UINT8(expected[i], copy.current_state);
+		TEST_ASSERT_EQUAL_UINT8(expected[i], ref.current_state);
+	}
+	TEST_ASSERT_EQUAL_INT(2, table_trans_cnt);
+	TEST_ASSERT_EQUAL_INT(2, table_entry_cnt);
+
+	/* The copy can be extended, the table loaded by reference is read only */
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK,
+		fsm_add_transition(&copy, &trans, STATE_S0, STATE_S2));
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_FAIL,
+		fsm_add_transition(&ref, &trans, STATE_S0, STATE_S2));
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_FAIL, fsm_load(&copy, &table, FSM_LOAD_COPY));
+	fsm_memory_usage(&ref, &usage);
+	TEST_ASSERT_EQUAL(0, usage.total);
+
+	fsm_deinit(&copy);
+	fsm_deinit(&ref);
+}
+
+void test_record_replay_table_loaded_by_reference(void) {
+	fsm_t fsm;
+	fsm_recorder_t rec;
+	size_t runs = 0;
+
+	fake_time = 0;
+	table_var = 0;
+	table_trans_cnt = table_entry_cnt = 0;
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_load(&fsm, &table, FSM_LOAD_REF);
+	fsm_recorder_init(&rec, 0);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_set_recorder(&fsm, &rec));
+	TEST_ASSERT_EQUAL_INT(1, rec.inputs_list.len);
+
+	for (fake_time = 0; fake_time <= 400; fake_time += 10) {
+		table_var = fake_time >= 20 && fake_time < 40 ? 1 : 0;
+		fsm_run(&fsm);
+	}
+	TEST_ASSERT_EQUAL_INT(1, table_trans_cnt);
+	TEST_ASSERT_EQUAL_INT(1, table_entry_cnt);
+	TEST_ASSERT_EQUAL_UINT8(STATE_S0, fsm.current_state);
+
+	/* Replay into a new instance with other initial input value */
+	table_var = 5;
+	table_trans_cnt = table_entry_cnt = 0;
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_load(&fsm, &table, FSM_LOAD_REF);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_replay(&fsm, rec.buf, rec.len, &runs));
+	TEST_ASSERT_EQUAL_INT(41, runs);
+	TEST_ASSERT_EQUAL_INT(1, table_trans_cnt);
+	TEST_ASSERT_EQUAL_INT(1, table_entry_cnt);
+	TEST_ASSERT_EQUAL_UINT8(STATE_S0, fsm.current_state);
+	TEST_ASSERT_EQUAL_INT(0, table_var);
+	fsm_recorder_deinit(&rec);
+}
+
+/* Rows sharing the events of the table, the first one is a prefix */
+static int shared_var;
+
+static const fsm_table_event_t shared_events[] = {
+	{&table_var, 1, eval_eq},
+	{&shared_var, 0, eval_eq},
+};
+
+static const fsm_table_row_t shared_rows[] = {
+	{.from_state = STATE_S0, .next_state = STATE_S1, .op = FSM_OP_AND,
+	 .events = 0, .events_len = 1},
+	{.from_state = STATE_S0, .next_state = STATE_S2, .op = FSM_OP_AND,
+	 .events = 0, .events_len = 2},
+};
+
+static const fsm_table_t shared_table = {
+	.rows = shared_rows,
+	.rows_len = sizeof shared_rows / sizeof shared_rows[0],
+	.events = shared_events,
+	.events_len = sizeof shared_events / sizeof shared_events[0],
+};
+
+void test_add_event_keeps_shared_table_events(void) {
+	fsm_t fsm;
+
+	table_var = 1;
+	shared_var = 0;
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_load(&fsm, &shared_table, FSM_LOAD_COPY));
+
+	/* The new event of the first row doesn't change the events of the second */
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_add_event_cmp(&fsm,
+		&fsm.trans_list.trans[0], &shared_var, 1, eval_eq));
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_UINT8(STATE_S2, fsm.current_state);
+
+	fsm_deinit(&fsm);
+}
+
+/* Async test, the operation is completed later as an ISR would do */
+static fsm_async_t async_op;
+static int async_starts, async_notified;
+static bool cb_start_async(fsm_async_t op, void *arg) {
+	async_op = op;
+	async_starts++;
+	return true;
+}
+static void cb_async_notify(fsm_t *fsm, void *arg) { async_notified++; }
+
+void test_async_action_holds_state_until_completed(void) {
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	fsm_input_t *result = NULL;
+	int var = 0, updates = 0;
+
+	fake_time = 0;
+	async_starts = async_notified = 0;
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_register_state_actions(&fsm, STATE_S1, NULL, NULL, cb_count, &updates,
+		NULL, NULL);
+	fsm_register_state_async(&fsm, STATE_S1, cb_start_async, NULL);
+	fsm_set_async_notify(&fsm, cb_async_notify, NULL);
+	fsm_get_async_result(&fsm, &result);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_cmp(&fsm, trans, &var, 1, eval_eq);
+	fsm_add_transition(&fsm, &trans, STATE_S1, STATE_S2);
+	fsm_add_event_input(&fsm, trans, result, 7, eval_eq);
+	fsm_add_transition(&fsm, &trans, STATE_S1, STATE_S0);
+	fsm_add_event_timeout(&fsm, trans, 100);
+
+	var = 1;
+	fsm_run(&fsm);
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(1, async_starts);
+
+	/* Neither the update action nor the events run while pending */
+	fake_time = 50;
+	fsm_run(&fsm);
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_UINT8(STATE_S1, fsm.current_state);
+	TEST_ASSERT_EQUAL_INT(0, updates);
+
+	/* Only the first completion is accepted */
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_async_complete(async_op, 7));
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_FAIL, fsm_async_complete(async_op, 3));
+	TEST_ASSERT_EQUAL_INT(1, async_notified);
+
+	/* The result selects the transition in the next run */
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_UINT8(STATE_S2, fsm.current_state);
+	TEST_ASSERT_EQUAL_INT(1, updates);
+
+	fsm_deinit(&fsm);
+}
+
+void test_async_action_is_aborted_by_timeout(void) {
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	fsm_input_t *result = NULL;
+
+	fake_time = 0;
+	async_starts = 0;
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_register_state_async(&fsm, STATE_S0, cb_start_async, NULL);
+	fsm_get_async_result(&fsm, &result);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_input(&fsm, trans, result, 7, eval_eq);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S2);
+	fsm_add_event_timeout(&fsm, trans, 100);
+
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(1, async_starts);
+
+	/* The operation hangs, the timeout still leaves the state */
+	fake_time = 100;
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_UINT8(STATE_S2, fsm.current_state);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_FAIL, fsm_async_complete(async_op, 7));
+	TEST_ASSERT_EQUAL_INT(0, result->val);
+
+	fsm_deinit(&fsm);
+}
+
+/* Pipeline of the bus test, each stage forwards the event to the next one */
+typedef struct {
+	fsm_bus_t *bus;
+	fsm_t *target;
+	fsm_input_t *input;
+} bus_stage_t;
+
+static void cb_forward(void *arg) {
+	bus_stage_t *stage = arg;
+	fsm_bus_emit(stage->bus, stage->target, stage->input, 1);
+}
+
+void test_bus_cascade_settles_in_one_pass(void) {
+	fsm_bus_t bus;
+	fsm_t button, menu, power;
+	fsm_trans_t *trans = NULL;
+	fsm_input_t menu_in, power_in;
+	int pressed = 0;
+	size_t delivered;
+	bus_stage_t to_menu = {&bus, &menu, &menu_in};
+	bus_stage_t to_power = {&bus, &power, &power_in};
+	fsm_input_init(&menu_in, 0);
+	fsm_input_init(&power_in, 0);
+
+	fsm_init(&button, STATE_S0, get_fake_time);
+	fsm_add_transition(&button, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_cmp(&button, trans, &pressed, 1, eval_eq);
+	fsm_register_trans_action(&button, trans, cb_forward, &to_menu);
+	fsm_init(&menu, STATE_S0, get_fake_time);
+	fsm_add_transition(&menu, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_input(&menu, trans, &menu_in, 1, eval_eq);
+	fsm_register_trans_action(&menu, trans, cb_forward, &to_power);
+	fsm_init(&power, STATE_S0, get_fake_time);
+	fsm_add_transition(&power, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_input(&power, trans, &power_in, 1, eval_eq);
+
+	/* Added in reverse order, run in topological order */
+	TEST_ASSERT_EQUAL(FSM_ERR_OK, fsm_bus_init(&bus, 4));
+	fsm_bus_add(&bus, &power);
+	fsm_bus_add(&bus, &menu);
+	fsm_bus_add(&bus, &button);
+	TEST_ASSERT_EQUAL(FSM_ERR_OK, fsm_bus_connect(&bus, &menu, &power));
+	TEST_ASSERT_EQUAL(FSM_ERR_OK, fsm_bus_connect(&bus, &button, &menu));
+	TEST_ASSERT_EQUAL(FSM_ERR_FAIL, fsm_bus_connect(&bus, &power, &button));
+	TEST_ASSERT_EQUAL(FSM_ERR_INVALID_PARAM, fsm_bus_add(&bus, &menu));
+
+	pressed = 1;
+	TEST_ASSERT_EQUAL(FSM_ERR_OK, fsm_bus_run(&bus, &delivered));
+	TEST_ASSERT_EQUAL_UINT(2, delivered);
+	TEST_ASSERT_EQUAL_INT(STATE_S1, button.current_state);
+	TEST_ASSERT_EQUAL_INT(STATE_S1, menu.current_state);
+	TEST_ASSERT_EQUAL_INT(STATE_S1, power.current_state);
+
+	/* Two values for the same input are delivered in consecutive passes */
+	fsm_bus_emit(&bus, &menu, &menu_in, 5);
+	fsm_bus_emit(&bus, &menu, &menu_in, 6);
+	fsm_bus_run(&bus, &delivered);
+	TEST_ASSERT_EQUAL_UINT(1, delivered);
+	TEST_ASSERT_EQUAL_INT(5, menu_in.val);
+	fsm_bus_run(&bus, &delivered);
+	TEST_ASSERT_EQUAL_UINT(1, delivered);
+	TEST_ASSERT_EQUAL_INT(6, menu_in.val);
+
+	/* The instances can be added to other bus after the deinit */
+	fsm_bus_deinit(&bus);
+	TEST_ASSERT_NULL(menu.bus);
+}
+
+void test_bus_member_removed_on_deinit(void) {
+	fsm_bus_t bus;
+	fsm_t first, middle, last;
+	fsm_trans_t *trans = NULL;
+	fsm_input_t middle_in, last_in;
+	size_t delivered;
+	fsm_input_init(&middle_in, 0);
+	fsm_input_init(&last_in, 0);
+
+	fsm_init(&first, STATE_S0, get_fake_time);
+	fsm_init(&middle, STATE_S0, get_fake_time);
+	fsm_add_transition(&middle, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_input(&middle, trans, &middle_in, 1, eval_eq);
+	fsm_init(&last, STATE_S0, get_fake_time);
+	fsm_add_transition(&last, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_input(&last, trans, &last_in, 1, eval_eq);
+
+	TEST_ASSERT_EQUAL(FSM_ERR_OK, fsm_bus_init(&bus, 4));
+	fsm_bus_add(&bus, &first);
+	fsm_bus_add(&bus, &middle);
+	fsm_bus_add(&bus, &last);
+	fsm_bus_connect(&bus, &first, &middle);
+	fsm_bus_connect(&bus, &middle, &last);
+	fsm_bus_emit(&bus, &middle, &middle_in, 1);
+	fsm_bus_emit(&bus, &last, &last_in, 1);
+
+	/* The instance, its connection and its event leave the bus */
+	TEST_ASSERT_EQUAL(FSM_ERR_OK, fsm_deinit(&middle));
+	TEST_ASSERT_NULL(middle.bus);
+	TEST_ASSERT_EQUAL_UINT(2, bus.nodes.len);
+	TEST_ASSERT_EQUAL_UINT(0, bus.edges.len);
+	TEST_ASSERT_EQUAL_UINT(1, bus.queue.len);
+	TEST_ASSERT_EQUAL_UINT(1, last.bus_rank);
+	TEST_ASSERT_EQUAL(FSM_ERR_INVALID_PARAM, fsm_bus_remove(&bus, &middle));
+
+	TEST_ASSERT_EQUAL(FSM_ERR_OK, fsm_bus_run(&bus, &delivered));
+	TEST_ASSERT_EQUAL_UINT(1, delivered);
+	TEST_ASSERT_EQUAL_INT(0, middle_in.val);
+	TEST_ASSERT_EQUAL_INT(STATE_S0, middle.current_state);
+	TEST_ASSERT_EQUAL_INT(STATE_S1, last.current_state);
+	TEST_ASSERT_EQUAL_UINT(0, bus.queue.len);
+
+	fsm_bus_deinit(&bus);
+	fsm_deinit(&first);
+	fsm_deinit(&last);
+}
+
+static void build_replay_fsm(fsm_t *fsm, int *var, fsm_input_t *in) {
+	static const char marks[] = "abc";
+	fsm_trans_t *trans = NULL;
+	fsm_init(fsm, STATE_S0, get_fake_time);
+	fsm_add_transition(fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_cmp(fsm, trans, var, 1, eval_eq);
+	fsm_register_trans_action(fsm, trans, cb_log, (void *)&marks[0]);
+	fsm_add_transition(fsm, &trans, STATE_S1, STATE_S2);
+	fsm_add_event_input(fsm, trans, in, -3, eval_eq);
+	fsm_add_event_timeout(fsm, trans, 30);
+	fsm_register_trans_action(fsm, trans, cb_log, (void *)&marks[1]);
+	fsm_add_transition(fsm, &trans, STATE_S2, STATE_S0);
+	fsm_add_event_timeout(fsm, trans, 20);
+	fsm_register_trans_action(fsm, trans, cb_log, (void *)&marks[2]);
+}
+
+void test_record_replay_reproduces_transitions(void) {
+	fsm_t fsm;
+	fsm_recorder_t rec;
+	fsm_input_t in;
+	int var = 0;
+	char recorded[sizeof log_buf];
+	size_t recorded_len, runs = 0;
+
+	fsm_input_init(&in, 0);
+	build_replay_fsm(&fsm, &var, &in);
+	fsm_recorder_init(&rec, 0);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_set_recorder(&fsm, &rec));
+	TEST_ASSERT_EQUAL_INT(2, rec.inputs_list.len);
+
+	for (fake_time = 0; fake_time <= 300; fake_time += 10) {
+		var = fake_time >= 30 && fake_time < 50 ? 1 : 0;
+		fsm_input_set(&in, fake_time >= 60 && fake_time < 250 ? -3 : 0);
+		if (fake_time == 200) {
+			var = 1;
+		}
+		fsm_run(&fsm);
+	}
+
+	memcpy(recorded, log_buf, log_len);
+	recorded_len = log_len;
+	TEST_ASSERT_EQUAL_UINT32(31, rec.runs);
+	TEST_ASSERT_LESS_THAN(31 * 3, rec.len);
+
+	/* Replay into a new instance with other initial input values */
+	log_len = 0;
+	var = 5;
+	fsm_input_init(&in, 7);
+	fake_time = 0;
+	build_replay_fsm(&fsm, &var, &in);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_replay(&fsm, rec.buf, rec.len, &runs));
+	TEST_ASSERT_EQUAL_INT(31, runs);
+	TEST_ASSERT_EQUAL_INT(recorded_len, log_len);
+	TEST_ASSERT_EQUAL_MEMORY(recorded, log_buf, log_len);
+	TEST_ASSERT_EQUAL_INT(0, var);
+
+	/* A truncated varint is detected */
+	const uint8_t corrupted[] = {0x80};
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_FAIL,
+		fsm_replay(&fsm, corrupted, sizeof corrupted, &runs));
+
+	/* The log is in ms, it can't keep the ticks of a 64-bit time source */
+	fsm_t ticks;
+	fsm_init(&ticks, STATE_S0, NULL);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_set_recorder(&ticks, &rec));
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_FAIL,
+		fsm_set_time_source(&ticks, get_fake_time_us, 1000));
+	fsm_set_recorder(&ticks, NULL);
+	fsm_set_time_source(&ticks, get_fake_time_us, 1000);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_INVALID_PARAM, fsm_set_recorder(&ticks, &rec));
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_INVALID_PARAM,
+		fsm_replay(&ticks, rec.buf, rec.len, &runs));
+	fsm_recorder_deinit(&rec);
+}
+
+#if defined(__linux__)
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static uint64_t write_ns, exit_ns;
+static void cb_exit_stamp(void *arg) { exit_ns = now_ns(); }
+
+static void read_eventfd(int fd, void *arg) {
+	uint64_t val;
+	if (read(fd, &val, sizeof val) == sizeof val) {
+		*(int *)arg = 1;
+	}
+}
+
+static void *write_eventfd(void *arg) {
+	uint64_t val = 1;
+	usleep(20000);
+	write_ns = now_ns();
+	if (write(*(int *)arg, &val, sizeof val) != sizeof val) {
+		write_ns = 0;
+	}
+	return NULL;
+}
+
+void test_linux_loop_wakes_on_eventfd(void) {
+	fsm_linux_loop_t loop;
+	fsm_linux_source_t src;
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	pthread_t writer;
+	int var = 0;
+	int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_linux_loop_init(&loop, 64, 1));
+	fsm_init(&fsm, STATE_S0, fsm_linux_get_ms);
+	fsm_register_state_actions(&fsm, STATE_S0, cb_enter_s0, NULL, cb_update_s0,
+		NULL, cb_exit_stamp, NULL);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_cmp(&fsm, trans, &var, 1, eval_eq);
+	fsm_linux_loop_add(&loop, &fsm);
+	fsm_linux_loop_add_fd(&loop, &src, efd, &fsm, read_eventfd, &var);
+
+	/* Execute the entry action */
+	fsm_linux_loop_run_once(&loop, 0);
+	TEST_ASSERT_EQUAL_INT(1, enter_s0_cnt);
+
+	/* The loop sleeps until the eventfd is written */
+	pthread_create(&writer, NULL, write_eventfd, &efd);
+	fsm_linux_loop_run_once(&loop, 1000);
+	pthread_join(writer, NULL);
+
+	TEST_ASSERT_EQUAL_INT(1, update_s0_cnt);
+	TEST_ASSERT_TRUE(write_ns != 0 && exit_ns >= write_ns);
+
+	/* Sub-ms reaction, with slack for a loaded machine */
+	char latency[48];
+	snprintf(latency, sizeof latency, "eventfd reaction: %llu us",
+		(unsigned long long)((exit_ns - write_ns) / 1000));
+	TEST_MESSAGE(latency);
+	TEST_ASSERT_LESS_THAN(1000000, exit_ns - write_ns);
+
+	fsm_linux_loop_deinit(&loop);
+	close(efd);
+}
+
+void test_linux_loop_runs_fd_instances_with_the_loop_clock(void) {
+	fsm_linux_loop_t loop;
+	fsm_linux_source_t src;
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	int var = 0;
+	uint64_t val = 1;
+	int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	/* The get_ms of the instance is far from the clock of the loop */
+	fake_time = fsm_linux_get_ms() + 0x80000000u;
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_linux_loop_init(&loop, 64, 1));
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_timeout(&fsm, trans, 1000);
+	fsm_linux_loop_add(&loop, &fsm);
+	fsm_linux_loop_add_fd(&loop, &src, efd, &fsm, read_eventfd, &var);
+	fsm_linux_loop_run_once(&loop, 0);
+
+	/* The fd runs the instance at the time of the wheel, the timeout keeps
+	going */
+	TEST_ASSERT_EQUAL_INT(sizeof val, write(efd, &val, sizeof val));
+	fsm_linux_loop_run_once(&loop, 100);
+	TEST_ASSERT_EQUAL_INT(1, var);
+	TEST_ASSERT_EQUAL_INT(STATE_S0, fsm.current_state);
+
+	fsm_linux_loop_deinit(&loop);
+	close(efd);
+}
+
+void test_linux_loop_wakes_on_timeout(void) {
+	fsm_linux_loop_t loop;
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_linux_loop_init(&loop, 64, 1));
+	fsm_init(&fsm, STATE_S0, fsm_linux_get_ms);
+	fsm_register_state_actions(&fsm, STATE_S0, NULL, NULL, cb_update_s0, NULL,
+		cb_exit_s0, NULL);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_timeout(&fsm, trans, 20);
+	fsm_linux_loop_add(&loop, &fsm);
+
+	/* Entry, then a single wake up on the timeout */
+	uint64_t start_ns = now_ns();
+	fsm_linux_loop_run_once(&loop, 1000);
+	TEST_ASSERT_EQUAL_INT(1, exit_s0_cnt);
+	TEST_ASSERT_EQUAL_INT(1, update_s0_cnt);
+	TEST_ASSERT_GREATER_OR_EQUAL(19000000, now_ns() - start_ns);
+
+	fsm_linux_loop_deinit(&loop);
+}
+#endif
+
+void test_dispatch_defers_actions_in_order(void) {
+	fsm_dispatch_t queue;
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	size_t executed = 0;
+	static const char e0 = 'a', u0 = 'b', x0 = 'c', t01 = 'd', e1 = 'e';
+
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_dispatch_init(&queue, 4));
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_set_dispatch(&fsm, &queue);
+	fsm_register_state_actions(&fsm, STATE_S0, cb_log, (void *)&e0, cb_log,
+		(void *)&u0, cb_log, (void *)&x0);
+	fsm_register_state_actions(&fsm, STATE_S1, cb_log, (void *)&e1, NULL, NULL,
+		NULL, NULL);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_timeout(&fsm, trans, 10);
+	fsm_register_trans_action(&fsm, trans, cb_log, (void *)&t01);
+
+	/* The state advances but no action is executed inside fsm_run() */
+	fsm_run(&fsm);
+	fake_time = 10;
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(0, log_len);
+	TEST_ASSERT_EQUAL_INT(STATE_S1, fsm.current_state);
+
+	/* The actions are executed in order when the queue is drained */
+	fsm_dispatch_drain(&queue, 0, &executed);
+	TEST_ASSERT_EQUAL_INT(4, executed);
+	TEST_ASSERT_EQUAL_UINT8_ARRAY("abdc", log_buf, 4);
+
+	/* A full queue drops the action and reports it */
+	for (int i = 0; i < 4; i++) {
+		fsm_dispatch_push(&queue, cb_log, (void *)&u0);
+	}
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_NO_MEM, fsm_run(&fsm));
+	TEST_ASSERT_EQUAL_INT(1, queue.dropped);
+
+	fsm_dispatch_deinit(&queue);
+}
+
+static fsm_err_t reenter_run_ret, reenter_add_ret, reenter_action_ret;
+static void cb_reenter(void *arg) {
+	fsm_t *fsm = arg;
+	fsm_trans_t *trans = NULL;
+	reenter_run_ret = fsm_run(fsm);
+	reenter_add_ret = fsm_add_transition(fsm, &trans, STATE_S1, STATE_S2);
+	reenter_action_ret = fsm_register_trans_action(fsm,
+		&fsm->trans_list.trans[0], cb_exit_s1, NULL);
+}
+
+void test_reentrant_calls_from_actions_are_rejected(void) {
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	fsm_snapshot_t snap;
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_register_state_actions(&fsm, STATE_S0, cb_reenter, &fsm, NULL, NULL,
+		cb_exit_s0, NULL);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_run(&fsm));
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_BUSY, reenter_run_ret);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_BUSY, reenter_add_ret);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_BUSY, reenter_action_ret);
+	TEST_ASSERT_EQUAL_INT(1, exit_s0_cnt);
+	TEST_ASSERT_EQUAL_INT(1, fsm.trans_list.len);
+
+	/* The transition is published */
+	fsm_get_snapshot(&fsm, &snap);
+	TEST_ASSERT_EQUAL_INT(STATE_S1, snap.state);
+	TEST_ASSERT_EQUAL_INT(STATE_S0, snap.prev_state);
+	TEST_ASSERT_EQUAL_INT(1, snap.seq);
+}
+
+#if defined(__linux__)
+#define STRESS_RUNS 200000
+
+static volatile bool stress_done;
+static int stress_errors;
+
+static void *stress_reader(void *arg) {
+	fsm_snapshot_t snap;
+	while (!__atomic_load_n(&stress_done, __ATOMIC_ACQUIRE)) {
+		fsm_get_snapshot((const fsm_t *)arg, &snap);
+
+		/* Each transition toggles the state, a torn snapshot breaks it */
+		bool valid = snap.state == (snap.seq & 1) &&
+			(snap.seq == 0 || snap.prev_state == (snap.state ^ 1));
+		if (!valid) {
+			__atomic_add_fetch(&stress_errors, 1, __ATOMIC_RELAXED);
+		}
+	}
+	return NULL;
+}
+
+void test_snapshot_concurrent_readers_stress(void) {
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	fsm_snapshot_t snap;
+	pthread_t readers[2];
+	fsm_init(&fsm, STATE_S0, NULL);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_transition(&fsm, &trans, STATE_S1, STATE_S0);
+
+	stress_done = false;
+	stress_errors = 0;
+	for (int i = 0; i < 2; i++) {
+		pthread_create(&readers[i], NULL, stress_reader, &fsm);
+	}
+
+	/* Each run makes a transition */
+	for (int i = 0; i < STRESS_RUNS; i++) {
+		fsm_run(&fsm);
+	}
+
+	__atomic_store_n(&stress_done, true, __ATOMIC_RELEASE);
+	for (int i = 0; i < 2; i++) {
+		pthread_join(readers[i], NULL);
+	}
+
+	TEST_ASSERT_EQUAL_INT(0, stress_errors);
+	fsm_get_snapshot(&fsm, &snap);
+	TEST_ASSERT_EQUAL_INT((uint16_t)STRESS_RUNS, snap.seq);
+}
+
+#define HOTSWAP_RUNS 100000
+#define HOTSWAP_DEFS 4
+
+/* States 0 and 1 of one definition are states 2 and 3 of the other */
+static const uint8_t hotswap_maps[2][4] = {{0, 1, 0, 1}, {2, 3, 2, 3}};
+
+static void *hotswap_owner(void *arg) {
+	fsm_t *fsm = arg;
+	for (int i = 0; i < HOTSWAP_RUNS; i++) {
+		fsm_run(fsm);
+		if (fsm->current_state > 3) {
+			__atomic_add_fetch(&stress_errors, 1, __ATOMIC_RELAXED);
+		}
+	}
+	__atomic_store_n(&stress_done, true, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+void test_publish_concurrent_with_run(void) {
+	fsm_t fsm, defs[HOTSWAP_DEFS], *free_defs[HOTSWAP_DEFS], *def;
+	fsm_trans_t *trans = NULL;
+	pthread_t owner;
+	size_t free_len = HOTSWAP_DEFS, published = 0, reclaimed = 0;
+	fsm_init(&fsm, 0, NULL);
+	fsm_add_transition(&fsm, &trans, 0, 1);
+	fsm_add_transition(&fsm, &trans, 1, 0);
+	for (int i = 0; i < HOTSWAP_DEFS; i++) {
+		free_defs[i] = &defs[i];
+	}
+
+	stress_done = false;
+	stress_errors = 0;
+	pthread_create(&owner, NULL, hotswap_owner, &fsm);
+
+	/* Publish new definitions while the owner runs the instance */
+	while (!__atomic_load_n(&stress_done, __ATOMIC_ACQUIRE)) {
+		if (free_len) {
+			uint8_t base = (published & 1) ? 0 : 2;
+			def = free_defs[--free_len];
+			fsm_init(def, base, NULL);
+			fsm_add_transition(def, &trans, base, base + 1);
+			fsm_add_transition(def, &trans, base + 1, base);
+			fsm_publish(&fsm, def, hotswap_maps[base / 2], 4);
+			published++;
+		}
+
+		fsm_reclaim(&fsm, &def);
+		if (def != NULL) {
+			free_defs[free_len++] = def;
+			reclaimed++;
+		}
+	}
+
+	pthread_join(owner, NULL);
+
+	/* Adopt the last definition and reclaim the rest */
+	fsm_run(&fsm);
+	for (fsm_reclaim(&fsm, &def); def != NULL; fsm_reclaim(&fsm, &def)) {
+		reclaimed++;
+	}
+
+	TEST_ASSERT_EQUAL_INT(0, stress_errors);
+	TEST_ASSERT_EQUAL_INT(published, reclaimed);
+	TEST_ASSERT_EQUAL_INT(2, fsm.trans_list.len);
+	TEST_ASSERT_EQUAL_INT(published & 1 ? 2 : 0, fsm.current_state & 2);
+}
+#endif
+
+void test_interleaved_events_keep_their_transition(void) {
+	fsm_t fsm;
+	fsm_trans_t *t1 = NULL, *t2 = NULL;
+	int a = 0, b = 0;
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_register_state_actions(&fsm, STATE_S1, cb_enter_s1, NULL, NULL, NULL, NULL, NULL);
+	fsm_register_state_actions(&fsm, STATE_S2, cb_enter_s2, NULL, NULL, NULL, NULL, NULL);
+	fsm_add_transition(&fsm, &t1, STATE_S0, STATE_S1);
+	fsm_add_transition(&fsm, &t2, STATE_S0, STATE_S2);
+	t1 = &fsm.trans_list.trans[0];
+	fsm_add_event_cmp(&fsm, t1, &a, 1, eval_eq);
+	fsm_add_event_cmp(&fsm, t2, &b, 1, eval_eq);
+	fsm_add_event_cmp(&fsm, t1, &b, 2, eval_eq);
+
+	/* S0 -> S1 needs a == 1 and b == 2 */
+	a = 1;
+	b = 1;
+	fsm_run(&fsm);
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(0, enter_s1_cnt);
+	TEST_ASSERT_EQUAL_INT(1, enter_s2_cnt);
+
+#if FSM_PACKED_LAYOUT
+	TEST_ASSERT_LESS_OR_EQUAL(16, sizeof(fsm_trans_t));
+	TEST_ASSERT_LESS_OR_EQUAL(16, sizeof(fsm_event_t));
+#endif
+}
+
+void test_publish_swaps_definition_at_next_run(void) {
+	fsm_t fsm, def_a, def_b, *def = NULL;
+	fsm_trans_t *trans = NULL;
+	fsm_snapshot_t snap;
+	int var = 0, enter_cnt = 0;
+	const uint8_t map[] = {10, 11};
+	fsm_init(&fsm, STATE_S0, get_fake_time);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_cmp(&fsm, trans, &var, 1, eval_eq);
+
+	/* def_a is replaced by def_b before the next run */
+	fsm_init(&def_a, 10, get_fake_time);
+	fsm_add_transition(&def_a, &trans, 10, 12);
+	fsm_init(&def_b, 10, get_fake_time);
+	fsm_add_transition(&def_b, &trans, 10, 11);
+	fsm_add_event_cmp(&def_b, trans, &var, 2, eval_eq);
+	fsm_register_state_actions(&def_b, 11, cb_count, &enter_cnt, NULL, NULL,
+		NULL, NULL);
+	fsm_register_state_async(&def_b, 11, cb_start_async, NULL);
+	fsm_set_state_budget(&fsm, STATE_S0, 1000, 0);
+	async_starts = 0;
+
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_publish(&fsm, &def_a, map, 2));
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, fsm_publish(&fsm, &def_b, map, 2));
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_INVALID_PARAM, fsm_publish(&fsm, &fsm, NULL, 0));
+
+	/* The old rule is gone and S0 is mapped to 10 without a new entry */
+	var = 1;
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(10, fsm.current_state);
+	fsm_get_snapshot(&fsm, &snap);
+	TEST_ASSERT_EQUAL_INT(10, snap.state);
+	TEST_ASSERT_EQUAL_INT(0, snap.seq);
+
+	var = 2;
+	fsm_run(&fsm);
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(11, fsm.current_state);
+	TEST_ASSERT_EQUAL_INT(1, enter_cnt);
+
+	/* The asynchronous actions and the budgets come with the definition */
+	TEST_ASSERT_EQUAL_INT(1, async_starts);
+	TEST_ASSERT_EQUAL_UINT(0, fsm.budgets.len);
+
+	/* def_a was never adopted, def_b holds the old definition */
+	fsm_reclaim(&fsm, &def);
+	TEST_ASSERT_EQUAL_PTR(&def_b, def);
+	TEST_ASSERT_NULL(def_b.trans_list.trans);
+	TEST_ASSERT_NULL(def_b.budgets.budgets);
+	fsm_reclaim(&fsm, &def);
+	TEST_ASSERT_EQUAL_PTR(&def_a, def);
+	fsm_reclaim(&fsm, &def);
+	TEST_ASSERT_NULL(def);
+}
+
 /* Main ----------------------------------------------------------------------*/
 int main(void) {
 	UNITY_BEGIN();
@@ -287,6 +1835,43 @@ int main(void) {
 	RUN_TEST(test_multiple_timeouts_choose_earliest);
 	RUN_TEST(test_large_time_jump);
 	RUN_TEST(test_timeout_without_time_fn_does_not_crash);
+	RUN_TEST(test_bitset_mode_evaluates_shared_predicates_once);
+	RUN_TEST(test_bitset_mode_is_built_at_run_and_falls_back);
+	RUN_TEST(test_input_events_are_cached_until_version_changes);
+	RUN_TEST(test_cached_input_events_are_evaluated_again_on_entry);
+	RUN_TEST(test_cached_input_events_still_check_timeout);
+	RUN_TEST(test_guard_expression_with_short_circuit);
+	RUN_TEST(test_guard_expression_not_and_invalid);
+	RUN_TEST(test_interleaved_events_keep_their_transition);
+	RUN_TEST(test_publish_swaps_definition_at_next_run);
+	RUN_TEST(test_wheel_runs_only_expired_instances);
+	RUN_TEST(test_wheel_runs_time64_instances_in_ticks);
+	RUN_TEST(test_sim_fast_forwards_to_inputs_and_timeouts);
+	RUN_TEST(test_record_replay_reproduces_transitions);
+	RUN_TEST(test_observers_are_notified_by_state);
+	RUN_TEST(test_budgets_report_dwell_and_action_violations);
+	RUN_TEST(test_time64_timeouts_are_anchored_without_drift);
+	RUN_TEST(test_deinit_frees_memory_counted_by_usage);
+	RUN_TEST(test_bus_cascade_settles_in_one_pass);
+	RUN_TEST(test_bus_member_removed_on_deinit);
+	RUN_TEST(test_context_is_passed_to_shared_callbacks);
+	RUN_TEST(test_context_change_discards_cached_results);
+	RUN_TEST(test_context_events_read_data_behind_context);
+	RUN_TEST(test_fleet_tracks_instances_by_state);
+	RUN_TEST(test_load_table_by_copy_and_by_reference);
+	RUN_TEST(test_record_replay_table_loaded_by_reference);
+	RUN_TEST(test_add_event_keeps_shared_table_events);
+	RUN_TEST(test_async_action_holds_state_until_completed);
+	RUN_TEST(test_async_action_is_aborted_by_timeout);
+	RUN_TEST(test_dispatch_defers_actions_in_order);
+	RUN_TEST(test_reentrant_calls_from_actions_are_rejected);
+#if defined(__linux__)
+	RUN_TEST(test_snapshot_concurrent_readers_stress);
+	RUN_TEST(test_publish_concurrent_with_run);
+	RUN_TEST(test_linux_loop_wakes_on_eventfd);
+	RUN_TEST(test_linux_loop_wakes_on_timeout);
+	RUN_TEST(test_linux_loop_runs_fd_instances_with_the_loop_clock);
+#endif
 	return UNITY_END();
 }
 
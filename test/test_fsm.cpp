@@ -0,0 +1,221 @@
+/**
+ ******************************************************************************
+ * @file           : test_fsm.cpp
+ * @author         : Mauricio Barroso Benavides
+ * @date           : Oct 18, 2026
+ * @brief          : Unity test cases for the FSM C++ coroutine layer
+ ******************************************************************************
+ * @attention
+ *
+ * MIT License
+ *
+ * Copyright (c) 2026 Mauricio Barroso Benavides
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm.hpp"
+#include "unity.h"
+
+/* Private typedef -----------------------------------------------------------*/
+/* State definitions */
+enum { STATE_S0 = 0, STATE_S1, STATE_S2 };
+
+/* Private variables ---------------------------------------------------------*/
+static uint32_t fake_time;
+static uint64_t fake_time_us;
+static int var;
+
+/* Private function prototypes -----------------------------------------------*/
+static bool eval_eq(int a, int b) { return a == b; }
+static uint32_t get_fake_time(void) { return fake_time; }
+static uint64_t get_fake_time_us(void) { return fake_time_us; }
+
+static void build_fsm(fsm_t *fsm) {
+	fsm_trans_t *trans = NULL;
+	fsm_init(fsm, STATE_S0, get_fake_time);
+	fsm_add_transition(fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_cmp(fsm, trans, &var, 1, eval_eq);
+	fsm_add_transition(fsm, &trans, STATE_S1, STATE_S2);
+	fsm_add_event_cmp(fsm, trans, &var, 2, eval_eq);
+}
+
+static fsm::task wait_states(fsm::machine &m, int *step, uint8_t *seen) {
+	co_await m.enter(STATE_S0);
+	*step = 1;
+	co_await m.enter(STATE_S1);
+	*seen = m.get().current_state;
+	*step = 2;
+	co_await m.transition(STATE_S1, STATE_S2);
+	*step = 3;
+}
+
+static fsm::task wait_timeout(fsm::machine &m, bool *res, bool *done) {
+	*res = co_await m.transition(FSM_STATE_ANY, STATE_S2, 50);
+	*done = true;
+}
+
+static fsm::task wait_and_run(fsm::machine &m, fsm_err_t *ret,
+		uint8_t *seen) {
+	co_await m.enter(STATE_S1);
+	*seen = m.get().current_state;
+	*ret = fsm_run(&m.get());
+}
+
+void setUp(void) {
+	fake_time = 0;
+	var = 0;
+}
+
+void tearDown(void) {
+	// Nothing to tear down
+}
+
+/* Test cases ----------------------------------------------------------------*/
+void test_coroutine_resumed_from_transition(void) {
+	fsm_t fsm;
+	int step = 0;
+	uint8_t seen = 0xFF;
+	build_fsm(&fsm);
+	fsm::machine m(fsm);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, m.status());
+
+	/* Already in S0, the coroutine waits for S1 */
+	wait_states(m, &step, &seen);
+	TEST_ASSERT_EQUAL_INT(1, step);
+	m.run();
+	TEST_ASSERT_EQUAL_INT(1, step);
+
+	/* Resumed inside the run that takes the transition */
+	var = 1;
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, m.run());
+	TEST_ASSERT_EQUAL_INT(2, step);
+	TEST_ASSERT_EQUAL_INT(STATE_S1, seen);
+
+	/* Instances run from C code resume the coroutines too */
+	var = 2;
+	fsm_run(&fsm);
+	fsm_run(&fsm);
+	TEST_ASSERT_EQUAL_INT(3, step);
+}
+
+void test_coroutine_wait_with_timeout(void) {
+	fsm_t fsm;
+	bool res = true, done = false;
+	build_fsm(&fsm);
+	fsm::machine m(fsm);
+	m.run();
+
+	wait_timeout(m, &res, &done);
+	fake_time = 40;
+	m.run();
+	TEST_ASSERT_FALSE(done);
+
+	/* The transition is not taken before the timeout */
+	fake_time = 50;
+	m.run();
+	TEST_ASSERT_TRUE(done);
+	TEST_ASSERT_FALSE(res);
+
+	/* A new wait is resumed by the transition */
+	done = false;
+	wait_timeout(m, &res, &done);
+	var = 1;
+	m.run();
+	m.run();
+	var = 2;
+	m.run();
+	TEST_ASSERT_TRUE(done);
+	TEST_ASSERT_TRUE(res);
+}
+
+void test_time64_instance_runs_in_ticks(void) {
+	fsm_t fsm;
+	fsm_trans_t *trans = NULL;
+	bool res = true, done = false;
+
+	/* The ms time wraps around during the timeouts */
+	fake_time_us = (uint64_t)UINT32_MAX * 1000;
+	fsm_init(&fsm, STATE_S0, NULL);
+	fsm_set_time_source(&fsm, get_fake_time_us, 1000);
+	fsm_add_transition(&fsm, &trans, STATE_S0, STATE_S1);
+	fsm_add_event_timeout(&fsm, trans, 5);
+	fsm_add_transition(&fsm, &trans, STATE_S1, STATE_S2);
+	fsm_add_event_timeout(&fsm, trans, 100);
+	fsm::machine m(fsm);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_INVALID_PARAM, m.run_at(0));
+	m.run();
+
+	fake_time_us += 4999;
+	m.run();
+	TEST_ASSERT_EQUAL_INT(STATE_S0, fsm.current_state);
+	fake_time_us += 1;
+	m.run();
+	TEST_ASSERT_EQUAL_INT(STATE_S1, fsm.current_state);
+
+	/* The timed waits use the same time */
+	wait_timeout(m, &res, &done);
+	fake_time_us += 50000;
+	m.run();
+	TEST_ASSERT_TRUE(done);
+	TEST_ASSERT_FALSE(res);
+}
+
+void test_coroutine_resumed_after_machine_run(void) {
+	fsm_t fsm;
+	fsm_err_t ret = FSM_ERR_FAIL;
+	uint8_t seen = 0xFF;
+	build_fsm(&fsm);
+	fsm::machine m(fsm);
+	m.run();
+
+	/* Resumed once the run returns, the instance can be run again */
+	wait_and_run(m, &ret, &seen);
+	var = 1;
+	m.run();
+	TEST_ASSERT_EQUAL_INT(STATE_S1, seen);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_OK, ret);
+
+	/* Run from C code it is resumed inside fsm_run() */
+	fsm_t other;
+	var = 0;
+	build_fsm(&other);
+	fsm::machine n(other);
+	fsm_run(&other);
+	wait_and_run(n, &ret, &seen);
+	var = 1;
+	fsm_run(&other);
+	TEST_ASSERT_EQUAL_INT(FSM_ERR_BUSY, ret);
+}
+
+/* Main ----------------------------------------------------------------------*/
+int main(void) {
+	UNITY_BEGIN();
+	RUN_TEST(test_coroutine_resumed_from_transition);
+	RUN_TEST(test_coroutine_wait_with_timeout);
+	RUN_TEST(test_time64_instance_runs_in_ticks);
+	RUN_TEST(test_coroutine_resumed_after_machine_run);
+	return UNITY_END();
+}
+
+/***************************** END OF FILE ************************************/